@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "lib/app.h"
+#include "lib/asset.h"
+#include "lib/command_list.h"
+#include "lib/constant.h"
+#include "lib/hash.h"
+#include "lib/job_system.h"
+
+#define BENCH_WIDTH 800
+#define BENCH_HEIGHT 600
+#define BENCH_DEFAULT_FRAMES 300
+#define BENCH_WARMUP_FRAMES 10
+#define BENCH_FRAME_STEP (1. / 60.)
+
+#define VERTEX_SHADER_SOURCE_FILE "shaders/vertex.glsl"
+#define FRAGMENT_SHADER_SOURCE_FILE "shaders/frag.glsl"
+
+constexpr int INSTANCED_GRID = 317; // 100489 instances
+constexpr int BIG_MESH_GRID = 1024; // 2 * 1024^2 triangles
+constexpr int CHURN_DRAWS = 10000;
+
+// State a scene keeps between its setup and its frames
+struct SceneState
+{
+    MeshHandle mesh = INVALID_MESH;
+    std::vector<ObjectUniforms> objects;
+};
+
+struct Scene
+{
+    const char *name;
+    void (*setup)(App &app, SceneState &state);
+    void (*frame)(App &app, SceneState &state, long frame); // May be null
+};
+
+static void quad(std::vector<Vec3f> &vertices, std::vector<unsigned int> &elements, float half)
+{
+    vertices = {{-half, half, 0.f}, {half, half, 0.f}, {-half, -half, 0.f}, {half, -half, 0.f}};
+    elements = {0, 1, 2, 1, 2, 3};
+}
+
+static void setup_single_quad(App &app, SceneState &)
+{
+    std::vector<Vec3f> vertices;
+    std::vector<unsigned int> elements;
+    quad(vertices, elements, 0.5f);
+    app.use_vertices(vertices, elements);
+}
+
+static void setup_instanced(App &app, SceneState &)
+{
+    std::vector<Vec3f> vertices;
+    std::vector<unsigned int> elements;
+    quad(vertices, elements, 1.f);
+    app.use_vertices(vertices, elements);
+
+    // Grid over the viewport, tinted by position, a job per band of rows
+    std::vector<InstanceData> instances(INSTANCED_GRID * INSTANCED_GRID);
+    float cell = 2.f / INSTANCED_GRID;
+    app.jobs().parallel_for(INSTANCED_GRID, 16, [&](size_t begin, size_t end, unsigned int)
+                            {
+                                for (size_t y = begin; y < end; y++)
+                                    for (int x = 0; x < INSTANCED_GRID; x++)
+                                    {
+                                        float u = (float)x / INSTANCED_GRID, v = (float)y / INSTANCED_GRID;
+                                        instances[y * INSTANCED_GRID + x] = InstanceData{{-1.f + (x + 0.5f) * cell, -1.f + (y + 0.5f) * cell, 0.f}, cell * 0.4f, {u, v, 1.f - u, 1.f}};
+                                    } });
+    app.use_instances(instances);
+}
+
+static void setup_big_mesh(App &app, SceneState &)
+{
+    // Regular grid, every cell two triangles, a job per band of rows
+    std::vector<Vec3f> vertices((BIG_MESH_GRID + 1) * (BIG_MESH_GRID + 1));
+    std::vector<unsigned int> elements(BIG_MESH_GRID * BIG_MESH_GRID * 6);
+    app.jobs().parallel_for(BIG_MESH_GRID + 1, 64, [&](size_t begin, size_t end, unsigned int)
+                            {
+                                for (size_t y = begin; y < end; y++)
+                                    for (int x = 0; x <= BIG_MESH_GRID; x++)
+                                        vertices[y * (BIG_MESH_GRID + 1) + x] = Vec3f{-0.9f + 1.8f * x / BIG_MESH_GRID, -0.9f + 1.8f * y / BIG_MESH_GRID, 0.f};
+
+                                for (size_t y = begin; y < std::min<size_t>(end, BIG_MESH_GRID); y++)
+                                    for (unsigned int x = 0; x < BIG_MESH_GRID; x++)
+                                    {
+                                        unsigned int i = y * (BIG_MESH_GRID + 1) + x;
+                                        const unsigned int cell[6] = {i, i + 1, i + BIG_MESH_GRID + 1, i + 1, i + BIG_MESH_GRID + 1, i + BIG_MESH_GRID + 2};
+                                        std::copy(cell, cell + 6, &elements[(y * BIG_MESH_GRID + x) * 6]);
+                                    } });
+    app.use_vertices(vertices, elements);
+}
+
+static void setup_uniform_churn(App &app, SceneState &state)
+{
+    std::vector<Vec3f> vertices;
+    std::vector<unsigned int> elements;
+    quad(vertices, elements, 0.02f);
+    state.mesh = app.add_mesh(vertices, elements);
+    state.objects.resize(CHURN_DRAWS);
+}
+
+static void frame_uniform_churn(App &app, SceneState &state, long frame)
+{
+    // Every object block changes every frame, transforms are updated on the job system
+    app.jobs().parallel_for(CHURN_DRAWS, 1024, [&](size_t begin, size_t end, unsigned int)
+                            {
+                                for (size_t i = begin; i < end; i++)
+                                {
+                                    float phase = (float)((i * 7 + frame) % 100) / 100.f;
+                                    state.objects[i] = ObjectUniforms{{-0.95f + 1.9f * (i % 100) / 100.f, -0.95f + 1.9f * (i / 100) / 100.f + 0.01f * phase, 0.f}, 1.f, {phase, 1.f - phase, 0.5f, 1.f}};
+                                } });
+    // One key for all, the stable sort keeps submission order and the image matches command_lists
+    for (int i = 0; i < CHURN_DRAWS; i++)
+        app.submit(state.mesh, state.objects[i]);
+}
+
+static void frame_command_lists(App &app, SceneState &state, long frame)
+{
+    // Same draws as uniform_churn, recorded into one command list per job and replayed in order
+    constexpr size_t LIST_DRAWS = 1024;
+    std::span<CommandList> lists = app.command_lists((CHURN_DRAWS + LIST_DRAWS - 1) / LIST_DRAWS);
+    app.jobs().parallel_for(CHURN_DRAWS, LIST_DRAWS, [&](size_t begin, size_t end, unsigned int)
+                            {
+                                CommandList &list = lists[begin / LIST_DRAWS];
+                                list.bind_mesh(state.mesh);
+                                for (size_t i = begin; i < end; i++)
+                                {
+                                    float phase = (float)((i * 7 + frame) % 100) / 100.f;
+                                    list.set_object(ObjectUniforms{{-0.95f + 1.9f * (i % 100) / 100.f, -0.95f + 1.9f * (i / 100) / 100.f + 0.01f * phase, 0.f}, 1.f, {phase, 1.f - phase, 0.5f, 1.f}});
+                                    list.draw();
+                                } });
+}
+
+constexpr Scene SCENES[] = {
+    {"single_quad", setup_single_quad, nullptr},
+    {"instanced_100k", setup_instanced, nullptr},
+    {"big_mesh_2m", setup_big_mesh, nullptr},
+    {"uniform_churn_10k", setup_uniform_churn, frame_uniform_churn},
+    {"command_lists_10k", setup_uniform_churn, frame_command_lists},
+};
+
+static void write_percentiles(FILE *out, const PercentileSummary &p)
+{
+    fprintf(out, "{\"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f}", p.p50, p.p95, p.p99);
+}
+
+static void run_scene(FILE *out, const Scene &scene, AppMode mode, bool render_thread, long n_frames, std::span<const std::string_view> v_shaders, std::span<const std::string_view> f_shaders)
+{
+    fprintf(stderr, "%s...\n", scene.name);
+    App app(BENCH_WIDTH, BENCH_HEIGHT, WIN_TITLE, mode);
+    if (render_thread)
+        app.use_render_thread();
+    app.use_fixed_clock(BENCH_FRAME_STEP);
+    app.use_shaders(v_shaders, f_shaders);
+    SceneState state;
+    scene.setup(app, state);
+
+    // Setup uploads and first-use costs stay out of the measured frames
+    long frame = 0;
+    for (; frame < BENCH_WARMUP_FRAMES; frame++)
+    {
+        if (scene.frame)
+            scene.frame(app, state, frame);
+        app.update();
+    }
+
+    app.enable_profiler();
+    unsigned long draw_calls = 0, issued = 0, elided = 0, jobs = 0, steals = 0;
+    size_t bytes_uploaded = 0;
+    std::vector<double> utilization(app.jobs().size());
+    for (long i = 0; i < n_frames; i++, frame++)
+    {
+        if (scene.frame)
+            scene.frame(app, state, frame);
+        app.update();
+        draw_calls += app.frame_stats().draw_calls;
+        bytes_uploaded += app.frame_stats().bytes_uploaded;
+        issued += app.gl_state_stats().issued;
+        elided += app.gl_state_stats().elided;
+        for (size_t worker = 0; worker < app.job_stats().size(); worker++)
+        {
+            const JobWorkerStats &stats = app.job_stats()[worker];
+            jobs += stats.jobs;
+            steals += stats.steals;
+            utilization[worker] += stats.utilization / n_frames;
+        }
+    }
+
+    // Distribution over the profiler's history, the most recent PROFILER_HISTORY frames
+    const FrameProfiler &profiler = *app.profiler();
+    ProfileSummary summary = profiler.summary();
+    std::vector<FrameRecord> records = profiler.records();
+    double min = records.empty() ? 0. : records[0].cpu_total_ms, max = min, sum = 0.;
+    for (const FrameRecord &record : records)
+    {
+        min = std::min(min, record.cpu_total_ms);
+        max = std::max(max, record.cpu_total_ms);
+        sum += record.cpu_total_ms;
+    }
+
+    // Last frame's pixels, the fixed clock makes them comparable across runs and commits
+    std::vector<unsigned char> pixels = app.read_pixels();
+    uint64_t image_hash = hash64(std::string_view((const char *)pixels.data(), pixels.size()));
+
+    fprintf(out, "    {\n      \"name\": \"%s\",\n      \"frames\": %ld,\n      \"profiled_frames\": %zu,\n", scene.name, n_frames, summary.n_frames);
+    fprintf(out, "      \"frame_ms\": {\"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f},\n",
+            records.empty() ? 0. : sum / records.size(), min, max, summary.cpu_total_ms.p50, summary.cpu_total_ms.p95, summary.cpu_total_ms.p99);
+    fprintf(out, "      \"phase_ms\": {");
+    for (int phase = 0; phase < N_FRAME_PHASE; phase++)
+    {
+        fprintf(out, "%s\"%s\": ", phase ? ", " : "", frame_phase_name((FramePhase)phase));
+        write_percentiles(out, summary.cpu_ms[phase]);
+    }
+    fprintf(out, "},\n      \"gpu_ms\": ");
+    if (summary.n_gpu_frames)
+        write_percentiles(out, summary.gpu_ms);
+    else
+        fprintf(out, "null");
+    fprintf(out, ",\n      \"draw_calls_per_frame\": %.1f,\n      \"bytes_uploaded_per_frame\": %.1f,\n", (double)draw_calls / n_frames, (double)bytes_uploaded / n_frames);
+    fprintf(out, "      \"gl_calls_per_frame\": {\"issued\": %.1f, \"elided\": %.1f},\n", (double)issued / n_frames, (double)elided / n_frames);
+    fprintf(out, "      \"jobs_per_frame\": {\"jobs\": %.1f, \"steals\": %.1f, \"worker_utilization\": [", (double)jobs / n_frames, (double)steals / n_frames);
+    for (size_t worker = 0; worker < utilization.size(); worker++)
+        fprintf(out, "%s%.3f", worker ? ", " : "", utilization[worker]);
+    fprintf(out, "]},\n");
+    fprintf(out, "      \"image_hash\": \"%016lx\"\n    }", (unsigned long)image_hash);
+}
+
+int main(int argc, char **argv)
+{
+    // Parse args, `bench [--software] [--render-thread] [--frames N] [--out file.json] [scene...]`
+    AppMode mode = AppMode::Headless;
+    bool render_thread = false;
+    long n_frames = BENCH_DEFAULT_FRAMES;
+    const char *out_path = nullptr;
+    std::vector<const Scene *> scenes;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--software") == 0)
+            mode = AppMode::Software;
+        else if (strcmp(argv[i], "--render-thread") == 0)
+            render_thread = true;
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            n_frames = atol(argv[++i]);
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            out_path = argv[++i];
+        else
+        {
+            auto scene = std::find_if(std::begin(SCENES), std::end(SCENES), [&](const Scene &scene)
+                                      { return strcmp(scene.name, argv[i]) == 0; });
+            if (scene == std::end(SCENES))
+            {
+                fprintf(stderr, "Unknown argument %s, scenes are:", argv[i]);
+                for (const Scene &scene : SCENES)
+                    fprintf(stderr, " %s", scene.name);
+                fprintf(stderr, "\n");
+                return 1;
+            }
+            scenes.push_back(&*scene);
+        }
+    }
+    if (scenes.empty())
+        for (const Scene &scene : SCENES)
+            scenes.push_back(&scene);
+    if (n_frames <= 0)
+        n_frames = BENCH_DEFAULT_FRAMES;
+
+    FILE *out = out_path ? fopen(out_path, "w") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "Failed to open %s\n", out_path);
+        return 1;
+    }
+
+    AssetLoader assets;
+    const std::string_view v_shaders[] = {assets.get(VERTEX_SHADER_SOURCE_FILE).text()};
+    const std::string_view f_shaders[] = {assets.get(FRAGMENT_SHADER_SOURCE_FILE).text()};
+
+    fprintf(out, "{\n  \"mode\": \"%s\",\n  \"render_thread\": %s,\n  \"width\": %d,\n  \"height\": %d,\n  \"warmup_frames\": %d,\n  \"frame_step_s\": %.6f,\n  \"scenes\": [\n",
+            mode == AppMode::Software ? "software" : "headless", render_thread && mode != AppMode::Software ? "true" : "false", BENCH_WIDTH, BENCH_HEIGHT, BENCH_WARMUP_FRAMES, BENCH_FRAME_STEP);
+    for (size_t i = 0; i < scenes.size(); i++)
+    {
+        run_scene(out, *scenes[i], mode, render_thread, n_frames, v_shaders, f_shaders);
+        fprintf(out, i + 1 < scenes.size() ? ",\n" : "\n");
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
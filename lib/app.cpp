@@ -1,14 +1,30 @@
 #include <math.h>
+#include <stdio.h>
+#include <string.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <format>
 #include <memory>
 #include <span>
 #include <string_view>
 #include <stdexcept>
+#include <vector>
 
 #include "app.h"
+#include "command_list.h"
 #include "constant.h"
+#include "gl_ext.h"
+#include "gl_state.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "raster.h"
+#include "render_thread.h"
+#include "shader_reload.h"
+#include "stream_buffer.h"
+#include "trace.h"
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height)
 {
@@ -16,50 +32,208 @@ void framebuffer_size_callback(GLFWwindow *window, int width, int height)
     glViewport(0, 0, width, height);
 }
 
-App::App(int width, int height, const std::string_view title)
+static Context make_context(int width, int height, const std::string_view title, AppMode mode)
 {
-    // Init glfw
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, APP_GLFW_CTX_VER_MAJOR);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, APP_GLFW_CTX_VER_MINOR);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    TRACE_SCOPE("make_context");
+    switch (mode)
+    {
+    case AppMode::Window:
+        return Context(width, height, title);
+    case AppMode::Headless:
+        return Context::headless(width, height);
+    default:
+        return Context();
+    }
+}
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+App::App(int width, int height, const std::string_view title, AppMode mode)
+    : m_context(make_context(width, height, title, mode)),
+      m_mode(mode),
+      m_width(width),
+      m_height(height),
+      m_fbo(0),
+      m_fbo_color(0),
+      m_should_close(false),
+      m_start(std::chrono::steady_clock::now()),
+      m_last_update{},
+      m_fixed_step(0.),
+      m_frame_index(0),
+      m_frame_stats{0, 0},
+      m_last_frame_stats{0, 0},
+      m_vertices_requested(0),
+      m_vertices_done(0),
+      m_uniform_alignment(0),
+      m_stream_va_id(0),
+      m_instance_buffer(0),
+      m_instance_capacity(0),
+      m_n_instances(0),
+      m_mesh(INVALID_MESH),
+      m_mesh_range{},
+      m_recording{},
+      m_rendering{},
+      m_frame_render_stats{0, 0, 0, 0},
+      m_render_stats{0, 0, 0, 0},
+      m_shader_prog(0),
+      m_va_id(0),
+      m_vb_id(0),
+      m_eb_id(0),
+      m_element_size(0)
+{
+    if (m_mode == AppMode::Software)
+    {
+        m_raster = std::make_unique<Rasterizer>(width, height, jobs());
+        return;
+    }
 
-    // Make window
-    GLFWwindow *window = glfwCreateWindow(width, height, title.data(), NULL, NULL);
-    if (window == NULL)
-        throw std::runtime_error("Failed to create GLFW window");
-    glfwMakeContextCurrent(window);
+    m_context.make_current();
 
     // Init glad
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-        throw std::runtime_error("Failed to initialize GLAD");
+    {
+        TRACE_SCOPE("gladLoadGLLoader");
+        if (!gladLoadGLLoader((GLADloadproc)m_context.loader()))
+            throw std::runtime_error("Failed to initialize GLAD");
+        gl_ext_load(m_context.loader());
+    }
+    m_program_cache = std::make_unique<ProgramCache>(PROGRAM_CACHE_DIR);
+
+    // Disabled instance arrays read the current generic value, make it the identity instance
+    const InstanceData &identity = INSTANCE_IDENTITY;
+    glVertexAttrib4f((unsigned int)VertexSemantic::InstanceTransform, identity.offset[0], identity.offset[1], identity.offset[2], identity.scale);
+    glVertexAttrib4fv((unsigned int)VertexSemantic::InstanceColor, identity.color);
 
     // Set view port
     glViewport(0, 0, width, height);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    if (m_mode == AppMode::Window)
+    {
+        glfwSetFramebufferSizeCallback(m_context.window(), framebuffer_size_callback);
+        return;
+    }
 
-    // set member
-    m_window = window;
+    // Offscreen target
+    glGenRenderbuffers(1, &m_fbo_color);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_fbo_color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_fbo_color);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Offscreen framebuffer is incomplete");
 }
 
 App::~App()
 {
-    glfwTerminate();
+    // GL objects are deleted here, take the context back
+    if (m_render_thread)
+    {
+        m_render_thread.reset();
+        m_context.make_current();
+    }
+
+    m_uploader.reset();
+    release_vertices();
+    for (auto [hash, program] : m_variants.programs())
+        glDeleteProgram(program);
+    if (m_instance_buffer)
+        glDeleteBuffers(1, &m_instance_buffer);
+    if (m_stream_va_id)
+        glDeleteVertexArrays(1, &m_stream_va_id);
+    if (m_fbo)
+    {
+        glDeleteFramebuffers(1, &m_fbo);
+        glDeleteRenderbuffers(1, &m_fbo_color);
+    }
+}
+
+double App::time() const noexcept
+{
+    if (m_fixed_step > 0.)
+        return m_frame_index * m_fixed_step;
+    if (m_mode == AppMode::Window)
+        return glfwGetTime();
+
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+void App::use_fixed_clock(double step) noexcept
+{
+    m_fixed_step = step;
+}
+
+ProgramCacheStats App::program_cache_stats() const noexcept
+{
+    if (!m_program_cache)
+        return ProgramCacheStats{0, 0, 0};
+
+    return m_program_cache->stats();
+}
+
+void App::enable_profiler()
+{
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { enable_profiler(); });
+
+    if (!m_profiler)
+        m_profiler = std::make_unique<FrameProfiler>(m_raster == nullptr);
+}
+
+const FrameProfiler *App::profiler() const noexcept
+{
+    if (m_render_thread)
+        m_render_thread->wait();
+    return m_profiler.get();
+}
+
+JobSystem &App::jobs()
+{
+    if (!m_jobs)
+        m_jobs = std::make_unique<JobSystem>();
+    return *m_jobs;
+}
+
+std::span<const JobWorkerStats> App::job_stats() const noexcept
+{
+    if (!m_jobs)
+        return {};
+    return m_jobs->last_frame();
+}
+
+std::vector<unsigned char> App::read_pixels() const
+{
+    if (m_raster)
+        return m_raster->read_pixels();
+    if (off_render_thread())
+    {
+        std::vector<unsigned char> pixels;
+        m_render_thread->call([&]
+                              { pixels = read_pixels(); });
+        return pixels;
+    }
+
+    std::vector<unsigned char> pixels((size_t)m_width * m_height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    return pixels;
 }
 
-unsigned int make_shader(GLenum shader_type, const std::span<const char *const> source)
+unsigned int make_shader(GLenum shader_type, const std::span<const std::string_view> source)
 {
+    TRACE_SCOPE(shader_type == GL_VERTEX_SHADER ? "make_shader vertex" : "make_shader fragment");
+
     // Create shader
     unsigned int shader = glCreateShader(shader_type);
     if (!shader)
         throw std::runtime_error("Shader creation failed");
 
-    // Compile
-    glShaderSource(shader, source.size(), source.data(), NULL);
+    // Compile, with explicit lengths since the sources are not null terminated
+    std::vector<const char *> strings(source.size());
+    std::vector<int> lengths(source.size());
+    for (size_t i = 0; i < source.size(); i++)
+    {
+        strings[i] = source[i].data();
+        lengths[i] = source[i].size();
+    }
+    glShaderSource(shader, source.size(), strings.data(), lengths.data());
     glCompileShader(shader);
 
     // Check for error
@@ -69,6 +243,7 @@ unsigned int make_shader(GLenum shader_type, const std::span<const char *const>
     if (!success)
     {
         glGetShaderInfoLog(shader, sizeof(inner_log), NULL, inner_log);
+        glDeleteShader(shader);
         throw std::runtime_error(std::format("Shader compilation failed\n{}", inner_log));
     }
 
@@ -76,96 +251,1106 @@ unsigned int make_shader(GLenum shader_type, const std::span<const char *const>
     return shader;
 }
 
-void App::use_shaders(const std::span<const char *const> v_info, const std::span<const char *const> f_info)
+unsigned int make_program(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info, ProgramCache *cache)
 {
+    TRACE_SCOPE("make_program");
+
     // Make Vertex Shader
     unsigned int v_shader = make_shader(GL_VERTEX_SHADER, v_info);
 
     // Make Fragment Shader
-    unsigned int f_shader = make_shader(GL_FRAGMENT_SHADER, f_info);
+    unsigned int f_shader;
+    try
+    {
+        f_shader = make_shader(GL_FRAGMENT_SHADER, f_info);
+    }
+    catch (...)
+    {
+        glDeleteShader(v_shader);
+        throw;
+    }
 
     // Create Shader Program
-    m_shader_prog = glCreateProgram();
-    if (!m_shader_prog)
+    unsigned int program = glCreateProgram();
+    if (!program)
+    {
+        glDeleteShader(v_shader);
+        glDeleteShader(f_shader);
         throw std::runtime_error("Failed to create shader program");
+    }
+    if (cache)
+        cache->prepare(program);
 
     // Link shader programs
-    glAttachShader(m_shader_prog, v_shader);
-    glAttachShader(m_shader_prog, f_shader);
-    glLinkProgram(m_shader_prog);
+    glAttachShader(program, v_shader);
+    glAttachShader(program, f_shader);
+    {
+        TRACE_SCOPE("glLinkProgram");
+        glLinkProgram(program);
+    }
+
+    // Delete shaders
+    glDeleteShader(v_shader);
+    glDeleteShader(f_shader);
+
     int success;
     char inner_log[GL_STACK_ERR_BUF_LEN];
-    glGetProgramiv(m_shader_prog, GL_LINK_STATUS, &success);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success)
     {
-        glGetProgramInfoLog(m_shader_prog, sizeof(inner_log), NULL, inner_log);
+        glGetProgramInfoLog(program, sizeof(inner_log), NULL, inner_log);
+        glDeleteProgram(program);
         throw std::runtime_error(std::format("Shader program linking failed\n{}", inner_log));
     }
 
-    // Delete shaders
-    glDeleteShader(v_shader);
-    glDeleteShader(f_shader);
+    return program;
+}
+
+// Blocks read from the generated binding points, the frame loop only binds ring ranges to them.
+// GL 3.3 has no layout(binding), so this is the one lookup by name, once per link
+static void bind_uniform_blocks(unsigned int program) noexcept
+{
+    for (unsigned int binding = 0; binding < std::size(shaders::UNIFORM_BLOCK_NAMES); binding++)
+    {
+        unsigned int block = glGetUniformBlockIndex(program, shaders::UNIFORM_BLOCK_NAMES[binding]);
+        if (block != GL_INVALID_INDEX)
+            glUniformBlockBinding(program, block, binding);
+    }
+}
+
+void App::use_shaders(const std::span<const char *const> v_info, const std::span<const char *const> f_info)
+{
+    std::vector<std::string_view> v_sources(v_info.begin(), v_info.end());
+    std::vector<std::string_view> f_sources(f_info.begin(), f_info.end());
+    use_shaders(v_sources, f_sources);
+}
+
+void App::use_shaders(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info)
+{
+    // The CPU backend has shaders/vertex.glsl and shaders/frag.glsl built in
+    if (m_raster)
+        return;
+
+    use_shaders(v_info, f_info, program_source_hash(v_info, f_info));
+}
+
+void App::use_shaders(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info, uint64_t source_hash)
+{
+    if (m_raster)
+        return;
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { use_shaders(v_info, f_info, source_hash); });
+
+    bind_program(build_program(v_info, f_info, source_hash));
+}
+
+unsigned int App::build_program(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info, uint64_t source_hash)
+{
+    // Reuse the binary of a previous run when the driver accepts it
+    uint64_t key = m_program_cache->key(source_hash);
+    unsigned int program = m_program_cache->load(key);
+    if (!program)
+    {
+        program = make_program(v_info, f_info, m_program_cache.get());
+        m_program_cache->count_compile();
+        m_program_cache->store(key, program);
+    }
+
+    bind_uniform_blocks(program);
+    return program;
+}
+
+ShaderVariant App::shader_variant(const std::string_view v_path, const std::string_view f_path, const std::span<const ShaderDefine> defines)
+{
+    if (m_raster)
+        return ShaderVariant{0};
+    if (off_render_thread())
+    {
+        ShaderVariant variant{0};
+        m_render_thread->call([&]
+                              { variant = shader_variant(v_path, f_path, defines); });
+        return variant;
+    }
+
+    return m_variants.get(v_path, f_path, defines, [this](std::span<const std::string_view> v_info, std::span<const std::string_view> f_info, uint64_t source_hash)
+                          { return build_program(v_info, f_info, source_hash); });
+}
+
+void App::bind_program(unsigned int program) noexcept
+{
+    if (m_shader_prog)
+    {
+        m_gl.forget_program(m_shader_prog);
+        glDeleteProgram(m_shader_prog);
+    }
+    m_shader_prog = program;
+
+    // Enumerate uniforms once, user lookups are answered from the table
+    m_uniforms.reflect(m_shader_prog);
 
     // Use prog
-    glUseProgram(m_shader_prog);
+    m_gl.use_program(m_shader_prog);
+}
+
+void App::watch_shaders(const std::string_view v_path, const std::string_view f_path)
+{
+    // The CPU backend does not run the shader files
+    if (m_raster)
+        return;
+
+    // Created here, GLFW makes windows on the main thread only, and swapped in while no frame polls it
+    if (m_render_thread)
+        m_render_thread->wait();
+
+    // Reload is a convenience, without a watch (no inotify, no directory) the app runs on as is
+    try
+    {
+        m_reloader = std::make_unique<ShaderReloader>(m_context, v_path, f_path);
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "Shader hot reload disabled: %s\n", e.what());
+    }
 }
 
 int App::uniform_location(const char *key) noexcept
 {
-    return glGetUniformLocation(m_shader_prog, key);
+    return m_uniforms.location(key);
 }
 
-void App::use_vertices(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements) noexcept
+int App::uniform_location(UniformKey key) noexcept
 {
+    return m_uniforms.location(key);
+}
+
+MeshRegistry &App::meshes()
+{
+    if (!m_meshes)
+    {
+        if (off_render_thread())
+        {
+            m_render_thread->call([&]
+                                  { (void)meshes(); });
+            return *m_meshes;
+        }
+        m_meshes = std::make_unique<MeshRegistry>(Vec3fLayout::attribs, MESH_REGISTRY_VERTICES, MESH_REGISTRY_INDICES, m_raster == nullptr);
+        m_gl.invalidate();
+        attach_instances();
+    }
+    return *m_meshes;
+}
+
+void App::release_vertices() noexcept
+{
+    if (m_va_id)
+    {
+        m_gl.forget_vertex_array(m_va_id);
+        m_gl.forget_buffer(m_vb_id);
+        m_gl.forget_buffer(m_eb_id);
+        glDeleteVertexArrays(1, &m_va_id);
+        glDeleteBuffers(1, &m_vb_id);
+        glDeleteBuffers(1, &m_eb_id);
+        m_va_id = m_vb_id = m_eb_id = 0;
+        m_element_size = 0;
+    }
+    if (m_mesh.valid())
+    {
+        m_meshes->destroy(m_mesh);
+        m_mesh = INVALID_MESH;
+    }
+}
+
+void App::use_vertices(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements)
+{
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { use_vertices(vertices, elements); });
+
+    MeshHandle mesh = add_mesh(vertices, elements);
+    supersede_upload();
+    release_vertices();
+    m_mesh = mesh;
+    m_mesh_range = m_meshes->range(mesh);
+}
+
+uint64_t App::use_vertices_async(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements)
+{
+    if (m_raster)
+    {
+        use_vertices(vertices, elements);
+        return 0;
+    }
+
+    // Created here like the shader reloader, GLFW makes windows on the main thread only
+    if (!m_uploader)
+    {
+        if (m_render_thread)
+            m_render_thread->wait();
+        m_uploader = std::make_unique<UploadService>(m_context);
+    }
+
+    uint64_t ticket = m_uploader->submit(std::as_bytes(vertices), elements);
+    m_vertices_requested.store(ticket, std::memory_order_release);
+    return ticket;
+}
+
+UploadStats App::upload_stats() const noexcept
+{
+    if (!m_uploader)
+        return UploadStats{0, 0, 0};
+
+    return m_uploader->stats();
+}
+
+void App::supersede_upload() noexcept
+{
+    // Requests come from the main thread only, none is submitted while this runs
+    m_vertices_done.store(m_vertices_requested.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+void App::drop_upload(const UploadService::Buffers &buffers) noexcept
+{
+    if (!buffers.ticket)
+        return;
+
+    glDeleteBuffers(1, &buffers.vertex_buffer);
+    glDeleteBuffers(1, &buffers.element_buffer);
+}
+
+void App::adopt_vertices(const UploadService::Buffers &buffers) noexcept
+{
+    release_vertices();
+    m_vb_id = buffers.vertex_buffer;
+    m_eb_id = buffers.element_buffer;
+    m_element_size = buffers.n_elements;
+
+    // The upload context's bindings are its own, the VAO is made here
+    glGenVertexArrays(1, &m_va_id);
+    m_gl.bind_vertex_array(m_va_id);
+    m_gl.bind_buffer(GL_ARRAY_BUFFER, m_vb_id);
+    m_gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_eb_id);
+    for (const VertexAttribDesc &attrib : Vec3fLayout::attribs)
+    {
+        glVertexAttribPointer(attrib.location, attrib.components, attrib.gl_type, attrib.normalized, attrib.stride, (void *)attrib.offset);
+        glEnableVertexAttribArray(attrib.location);
+    }
+    attach_instances();
+    m_vertices_done.store(buffers.ticket, std::memory_order_release);
+}
+
+MeshHandle App::add_mesh(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements)
+{
+    if (off_render_thread())
+    {
+        MeshHandle mesh = INVALID_MESH;
+        m_render_thread->call([&]
+                              { mesh = add_mesh(vertices, elements); });
+        return mesh;
+    }
+
+    // Uploads and growth bind behind the state cache
+    MeshHandle mesh = meshes().create(std::as_bytes(vertices), elements);
+    m_gl.invalidate();
+    m_frame_stats.bytes_uploaded += vertices.size_bytes() + elements.size_bytes();
+    return mesh;
+}
+
+void App::remove_mesh(MeshHandle mesh)
+{
+    // Pieces not streamed yet go first, the frame being recorded must not write a dead mesh
+    if (m_streaming)
+    {
+        m_streaming->cancel(mesh);
+        std::erase_if(m_recording.upload_chunks, [&](const UploadChunk &chunk)
+                      { return chunk.mesh == mesh; });
+    }
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { meshes().destroy(mesh); });
+
+    meshes().destroy(mesh);
+}
+
+UploadScheduler &App::streaming()
+{
+    if (!m_streaming)
+        m_streaming = std::make_unique<UploadScheduler>(UPLOAD_FRAME_BUDGET_BYTES, UPLOAD_FRAME_TARGET);
+    return *m_streaming;
+}
+
+MeshHandle App::stream_mesh(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements, float priority)
+{
+    // Only the room is made now, growth binds behind the state cache
+    MeshHandle mesh = INVALID_MESH;
+    auto reserve = [&]
+    {
+        mesh = meshes().reserve(std::as_bytes(vertices), elements);
+        m_gl.invalidate();
+    };
+    if (off_render_thread())
+        m_render_thread->call(reserve);
+    else
+        reserve();
+
+    streaming().add(mesh, std::as_bytes(vertices), elements, priority);
+    return mesh;
+}
+
+bool App::set_stream_priority(MeshHandle mesh, float priority)
+{
+    return m_streaming && m_streaming->set_priority(mesh, priority);
+}
+
+bool App::mesh_ready(MeshHandle mesh)
+{
+    return meshes().complete(mesh);
+}
+
+void App::set_upload_budget(size_t bytes_per_frame, double frame_target)
+{
+    streaming().configure(bytes_per_frame, frame_target);
+}
+
+UploadSchedulerStats App::stream_stats() const noexcept
+{
+    if (!m_streaming)
+        return UploadSchedulerStats{0, 0, UPLOAD_FRAME_BUDGET_BYTES, 0};
+
+    return m_streaming->stats();
+}
+
+void App::schedule_uploads(FrameRecording &frame)
+{
+    auto now = std::chrono::steady_clock::now();
+    double frame_seconds = m_last_update == std::chrono::steady_clock::time_point{} ? 0. : std::chrono::duration<double>(now - m_last_update).count();
+    m_last_update = now;
+    if (!m_streaming)
+        return;
+
+    // Complete from this frame on, its draws come after the writes
+    size_t first = frame.upload_chunks.size();
+    m_streaming->schedule(frame_seconds, frame.upload_chunks, frame.upload_staging);
+    for (size_t i = first; i < frame.upload_chunks.size(); i++)
+        if (frame.upload_chunks[i].last)
+            m_meshes->set_complete(frame.upload_chunks[i].mesh);
+}
+
+void App::write_uploads(FrameRecording &frame) noexcept
+{
+    for (const UploadChunk &chunk : frame.upload_chunks)
+    {
+        // Empty ones only mark a mesh complete, schedule_uploads already did
+        if (chunk.size == 0)
+            continue;
+        const std::byte *data = frame.upload_staging.data() + chunk.data;
+        if (chunk.elements)
+            m_meshes->write_elements(chunk.mesh, chunk.offset / sizeof(unsigned int), std::span((const unsigned int *)data, chunk.size / sizeof(unsigned int)));
+        else
+            m_meshes->write_vertices(chunk.mesh, chunk.offset, std::span(data, chunk.size));
+        m_frame_stats.bytes_uploaded += chunk.size;
+    }
+    if (!frame.upload_chunks.empty() && !m_raster)
+        m_gl.invalidate_buffer(GL_COPY_WRITE_BUFFER);
+    frame.upload_chunks.clear();
+    frame.upload_staging.clear();
+}
+
+void App::submit(MeshHandle mesh, float depth, uint32_t material, RenderPass pass)
+{
+    // Resolved now, update() only sees plain ranges. The program is left to the draw, a reload may
+    // replace it on the render thread meanwhile.
+    MeshRegistry &registry = meshes();
+    DrawItem item{registry.range(mesh), 0, registry.vao(), material, NO_OBJECT};
+    m_recording.queue.submit(item, render_key(pass, item.program, item.vao, material, depth));
+}
+
+void App::submit(MeshHandle mesh, ShaderVariant variant, float depth, uint32_t material, RenderPass pass)
+{
+    MeshRegistry &registry = meshes();
+    DrawItem item{registry.range(mesh), variant.program, registry.vao(), material, NO_OBJECT};
+    m_recording.queue.submit(item, render_key(pass, item.program, item.vao, material, depth));
+}
+
+void App::submit(MeshHandle mesh, const ObjectUniforms &object, float depth, uint32_t material, RenderPass pass)
+{
+    // Copied into the ring when drawn, once the frame's block count is known
+    MeshRegistry &registry = meshes();
+    DrawItem item{registry.range(mesh), 0, registry.vao(), material, m_recording.objects.size()};
+    m_recording.objects.push_back(object);
+    if (m_raster)
+        m_frame_stats.bytes_uploaded += sizeof(object);
+    m_recording.queue.submit(item, render_key(pass, item.program, item.vao, material, depth));
+}
+
+std::span<CommandList> App::command_lists(size_t n)
+{
+    // Resolved against by the recording threads, created here so they never race to it
+    const MeshRegistry *registry = &meshes();
+    std::vector<CommandList> &lists = m_recording.command_lists;
+    if (lists.size() < n)
+        lists.resize(n, CommandList(registry));
+    for (size_t i = 0; i < n; i++)
+        lists[i].clear();
+    m_recording.n_command_lists = n;
+    return std::span(lists).first(n);
+}
+
+void App::reserve_uniforms(size_t bytes_per_frame)
+{
+    if (m_raster)
+        return;
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { reserve_uniforms(bytes_per_frame); });
+
+    if (m_uniform_ring)
+        m_gl.forget_buffer(m_uniform_ring->id());
+    m_uniform_ring = std::make_unique<StreamBuffer>(bytes_per_frame);
+    m_gl.invalidate_buffer(GL_COPY_WRITE_BUFFER);
+
+    int alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    m_uniform_alignment = std::max(alignment, 1);
+}
+
+void App::fit_uniforms(size_t n_blocks)
+{
+    if (!m_uniform_ring)
+        reserve_uniforms(UNIFORM_RING_FRAME_BYTES);
+
+    // Every block padded to the alignment, one more for the start of the segment
+    size_t stride = (std::max(sizeof(FrameUniforms), sizeof(ObjectUniforms)) + m_uniform_alignment - 1) / m_uniform_alignment * m_uniform_alignment;
+    size_t bytes = (n_blocks + 1) * stride;
+    if (bytes > m_uniform_ring->segment_size())
+        reserve_uniforms(std::max(bytes, m_uniform_ring->segment_size() * 2));
+}
+
+size_t App::write_uniforms(const void *block, size_t size)
+{
+    // Written straight into GPU visible memory, no upload call per block
+    StreamAllocation allocation = m_uniform_ring->allocate(size, m_uniform_alignment);
+    memcpy(allocation.data, block, size);
+    m_gl.invalidate_buffer(GL_COPY_WRITE_BUFFER);
+    m_frame_stats.bytes_uploaded += size;
+    return allocation.offset;
+}
+
+MeshRegistryStats App::mesh_stats() const noexcept
+{
+    if (!m_meshes)
+        return MeshRegistryStats{0, 0, 0, 0, 0, 0};
+
+    return m_meshes->stats();
+}
+
+// Positions for the CPU backend, which only consumes float xyz
+static std::vector<Vec3f> gather_positions(const std::span<const VertexAttribDesc> attribs, const std::span<const std::span<const std::byte>> streams)
+{
+    auto position = std::find_if(attribs.begin(), attribs.end(), [](const VertexAttribDesc &attrib)
+                                 { return attrib.semantic == VertexSemantic::Position; });
+    if (position == attribs.end() || position->gl_type != GL_FLOAT || position->components < N_VEC3F_COMPONENT)
+        throw std::runtime_error("The software backend needs float xyz positions");
+
+    const std::span<const std::byte> stream = streams[position->stream];
+    std::vector<Vec3f> positions(stream.size() / position->stride);
+    for (size_t i = 0; i < positions.size(); i++)
+        memcpy(&positions[i], stream.data() + i * position->stride + position->offset, sizeof(Vec3f));
+    return positions;
+}
+
+void App::use_vertex_data(const std::span<const VertexAttribDesc> attribs, const std::span<const std::span<const std::byte>> streams, const std::span<const unsigned int> elements)
+{
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { use_vertex_data(attribs, streams, elements); });
+
+    for (std::span<const std::byte> stream : streams)
+        m_frame_stats.bytes_uploaded += stream.size();
+    m_frame_stats.bytes_uploaded += elements.size_bytes();
+
+    if (m_raster)
+    {
+        m_raster->use_vertices(gather_positions(attribs, streams), elements);
+        release_vertices();
+        return;
+    }
+
+    // Replaces the previous vertices, whichever path set them
+    supersede_upload();
+    release_vertices();
+
     // Set member var
     m_element_size = elements.size();
 
     // Make buffer
     glGenVertexArrays(1, &m_va_id);
-    glBindVertexArray(m_va_id);
+    m_gl.bind_vertex_array(m_va_id);
 
-    // Bind and set buffer
-    unsigned int vb_id;
-    glGenBuffers(1, &vb_id);
-    glBindBuffer(GL_ARRAY_BUFFER, vb_id);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vec3f), vertices.data(), GL_STATIC_DRAW);
+    // Bind and set buffer, streams go back to back into one buffer
+    std::vector<size_t> stream_offsets(streams.size());
+    size_t vb_size = 0;
+    for (size_t i = 0; i < streams.size(); i++)
+    {
+        stream_offsets[i] = vb_size;
+        vb_size = vertex_align(vb_size + streams[i].size());
+    }
+    glGenBuffers(1, &m_vb_id);
+    m_gl.bind_buffer(GL_ARRAY_BUFFER, m_vb_id);
+    glBufferData(GL_ARRAY_BUFFER, vb_size, NULL, GL_STATIC_DRAW);
+    for (size_t i = 0; i < streams.size(); i++)
+        glBufferSubData(GL_ARRAY_BUFFER, stream_offsets[i], streams[i].size(), streams[i].data());
 
     // Bind and set element buffer
-    unsigned int eb_id;
-    glGenBuffers(1, &eb_id);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, eb_id);
+    glGenBuffers(1, &m_eb_id);
+    m_gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_eb_id);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(unsigned int), elements.data(), GL_STATIC_DRAW);
 
-    // Set attribute pointer
-    glVertexAttribPointer(0, N_VEC3F_COMPONENT, GL_FLOAT, GL_FALSE, sizeof(Vec3f), (void *)0);
-    glEnableVertexAttribArray(0);
+    // Set attribute pointers
+    for (const VertexAttribDesc &attrib : attribs)
+    {
+        size_t offset = stream_offsets[attrib.stream] + attrib.offset;
+        glVertexAttribPointer(attrib.location, attrib.components, attrib.gl_type, attrib.normalized, attrib.stride, (void *)offset);
+        glEnableVertexAttribArray(attrib.location);
+    }
+    attach_instances();
+}
+
+void App::attach_instances() noexcept
+{
+    if (!m_instance_buffer)
+        return;
+
+    // Instance attributes live in the mesh VAOs and advance once per instance
+    for (unsigned int vao : {m_va_id, m_meshes ? m_meshes->vao() : 0u})
+    {
+        if (!vao)
+            continue;
+        m_gl.bind_vertex_array(vao);
+        m_gl.bind_buffer(GL_ARRAY_BUFFER, m_instance_buffer);
+        for (const VertexAttribDesc &attrib : InstanceLayout::attribs)
+        {
+            glVertexAttribPointer(attrib.location, attrib.components, attrib.gl_type, attrib.normalized, attrib.stride, (void *)attrib.offset);
+            glVertexAttribDivisor(attrib.location, 1);
+            glEnableVertexAttribArray(attrib.location);
+        }
+    }
+}
+
+void App::draw_elements(int count, size_t first_index, int base_vertex) noexcept
+{
+    m_frame_stats.draw_calls++;
+    void *indices = (void *)(first_index * sizeof(unsigned int));
+    if (m_n_instances)
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, count, GL_UNSIGNED_INT, indices, m_n_instances, base_vertex);
+    else
+        glDrawElementsBaseVertex(GL_TRIANGLES, count, GL_UNSIGNED_INT, indices, base_vertex);
+}
+
+void App::use_instances(const std::span<const InstanceData> instances)
+{
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { use_instances(instances); });
+
+    m_n_instances = instances.size();
+    m_frame_stats.bytes_uploaded += instances.size_bytes();
+    if (m_raster)
+    {
+        m_cpu_instances.assign(instances.begin(), instances.end());
+        return;
+    }
+
+    if (instances.empty())
+        return;
+
+    // Grow geometrically, a count creeping up frame by frame does not reallocate every frame
+    if (instances.size() > m_instance_capacity)
+    {
+        m_instance_capacity = std::max(instances.size(), m_instance_capacity * 2);
+        bool attach = !m_instance_buffer;
+        if (attach)
+            glGenBuffers(1, &m_instance_buffer);
+        m_gl.bind_buffer(GL_ARRAY_BUFFER, m_instance_buffer);
+        glBufferData(GL_ARRAY_BUFFER, m_instance_capacity * sizeof(InstanceData), NULL, GL_DYNAMIC_DRAW);
+        if (attach)
+            attach_instances();
+    }
+
+    m_gl.bind_buffer(GL_ARRAY_BUFFER, m_instance_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size_bytes(), instances.data());
+}
+
+void App::update_instances(size_t first, const std::span<const InstanceData> instances)
+{
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { update_instances(first, instances); });
+
+    if (first > m_n_instances || instances.size() > m_n_instances - first)
+        throw std::runtime_error(std::format("Instances [{}, {}) out of range, {} in use", first, first + instances.size(), m_n_instances));
+    m_frame_stats.bytes_uploaded += instances.size_bytes();
+
+    if (m_raster)
+    {
+        std::copy(instances.begin(), instances.end(), m_cpu_instances.begin() + first);
+        return;
+    }
+
+    m_gl.bind_buffer(GL_ARRAY_BUFFER, m_instance_buffer);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(InstanceData), instances.size_bytes(), instances.data());
+}
+
+void App::reserve_dynamic_geometry(size_t bytes_per_frame)
+{
+    if (m_raster)
+        return;
+    if (off_render_thread())
+        return m_render_thread->call([&]
+                                     { reserve_dynamic_geometry(bytes_per_frame); });
+
+    if (m_stream)
+        m_gl.forget_buffer(m_stream->id());
+    m_stream = std::make_unique<StreamBuffer>(bytes_per_frame);
+    m_gl.invalidate_buffer(GL_COPY_WRITE_BUFFER);
+
+    // One VAO reads every batch, batches differ by base vertex and index offset
+    if (!m_stream_va_id)
+        glGenVertexArrays(1, &m_stream_va_id);
+    m_gl.bind_vertex_array(m_stream_va_id);
+    m_gl.bind_buffer(GL_ARRAY_BUFFER, m_stream->id());
+    m_gl.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_stream->id());
+    glVertexAttribPointer(shaders::vertex::A_POS_LOCATION, N_VEC3F_COMPONENT, GL_FLOAT, GL_FALSE, sizeof(Vec3f), (void *)0);
+    glEnableVertexAttribArray(shaders::vertex::A_POS_LOCATION);
+}
+
+DynamicGeometry App::dynamic_geometry(size_t n_vertices, size_t n_elements)
+{
+    if (m_recording.n_dynamic_draws == m_recording.dynamic_draws.size())
+        m_recording.dynamic_draws.emplace_back();
+    DynamicDraw &draw = m_recording.dynamic_draws[m_recording.n_dynamic_draws];
+    draw.count = n_elements;
+
+    // The render thread counts its copy into the ring
+    if (!m_render_thread)
+        m_frame_stats.bytes_uploaded += n_vertices * sizeof(Vec3f) + n_elements * sizeof(unsigned int);
+
+    // Staged, the rasterizer draws from CPU memory and the render thread copies them when drawn
+    if (m_raster || m_render_thread)
+    {
+        draw.cpu_vertices.resize(n_vertices);
+        draw.cpu_elements.resize(n_elements);
+        m_recording.n_dynamic_draws++;
+        return DynamicGeometry{draw.cpu_vertices, draw.cpu_elements};
+    }
+
+    m_recording.n_dynamic_draws++;
+    return stream_geometry(draw, n_vertices, n_elements);
+}
+
+DynamicGeometry App::stream_geometry(DynamicDraw &draw, size_t n_vertices, size_t n_elements)
+{
+    if (!m_stream)
+        reserve_dynamic_geometry(DYNAMIC_GEOMETRY_FRAME_BYTES);
+
+    // Vertices aligned to their size so the offset is a whole base vertex
+    StreamAllocation vertices = m_stream->allocate(n_vertices * sizeof(Vec3f), sizeof(Vec3f));
+    StreamAllocation elements = m_stream->allocate(n_elements * sizeof(unsigned int), sizeof(unsigned int));
+    m_gl.invalidate_buffer(GL_COPY_WRITE_BUFFER);
+    draw.base_vertex = vertices.offset / sizeof(Vec3f);
+    draw.index_offset = elements.offset;
+    return DynamicGeometry{
+        std::span<Vec3f>((Vec3f *)vertices.data, n_vertices),
+        std::span<unsigned int>((unsigned int *)elements.data, n_elements)};
+}
+
+void App::close() noexcept
+{
+    m_should_close = true;
 }
 
 bool App::done() noexcept
 {
-    return glfwWindowShouldClose(m_window);
+    if (m_mode != AppMode::Window)
+        return m_should_close;
+
+    return m_should_close || glfwWindowShouldClose(m_context.window());
 }
 
-void App::update() noexcept
+bool App::off_render_thread() const noexcept
+{
+    return m_render_thread && !m_render_thread->current();
+}
+
+void App::use_render_thread()
+{
+    // The CPU backend has no context to move, its rasterizer already runs on worker threads
+    if (m_raster || m_render_thread)
+        return;
+
+    m_context.release();
+    try
+    {
+        m_render_thread = std::make_unique<RenderThread>(m_context);
+    }
+    catch (...)
+    {
+        m_context.make_current();
+        throw;
+    }
+
+    // Resizes arrive with the events on this thread, the viewport follows on the render thread
+    if (m_mode == AppMode::Window)
+    {
+        glfwSetWindowUserPointer(m_context.window(), this);
+        glfwSetFramebufferSizeCallback(m_context.window(), [](GLFWwindow *window, int width, int height)
+                                       {
+                                           printf("New dimensions - width: %d, height: %d\n", width, height);
+                                           App *app = (App *)glfwGetWindowUserPointer(window);
+                                           app->m_render_thread->post([width, height]
+                                                                      { glViewport(0, 0, width, height); }); });
+    }
+}
+
+FrameUniforms App::input() noexcept
 {
     // Handle escape key press
-    if (glfwGetKey(m_window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-        glfwSetWindowShouldClose(m_window, true);
+    if (m_mode == AppMode::Window && glfwGetKey(m_context.window(), GLFW_KEY_ESCAPE) == GLFW_PRESS)
+        glfwSetWindowShouldClose(m_context.window(), true);
+
+    // Set color offset according to time
+    float color_offset = ((float)sin(time()) + 1.f) / 2.f; // offset between 0. to 1.
+    float pos_offset = (color_offset / 2.f) - 0.25f;       // offset between -0.25 to 0.25
+    return FrameUniforms{color_offset, pos_offset, {}};
+}
+
+void App::poll_events() noexcept
+{
+    if (m_mode == AppMode::Window)
+        glfwPollEvents();
+}
+
+void App::update() noexcept
+{
+    TRACE_SCOPE("frame");
+    schedule_uploads(m_recording);
+    if (m_render_thread)
+    {
+        // Input and events are handled here while the render thread draws and swaps the previous
+        // frame, it only waits when that frame is still not done by the time this one is recorded
+        {
+            TRACE_SCOPE("input");
+            m_recording.uniforms = input();
+        }
+        {
+            TRACE_SCOPE("wait render");
+            m_render_thread->wait();
+        }
+        std::swap(m_recording, m_rendering);
+        end_frame();
+        m_render_thread->post([this]
+                              {
+                                  TRACE_SCOPE("render frame");
+                                  if (m_profiler)
+                                      m_profiler->begin_frame();
+                                  render(m_rendering);
+                                  end_profile(); });
+
+        TRACE_SCOPE("poll");
+        poll_events();
+        return;
+    }
+
+    if (m_profiler)
+        m_profiler->begin_frame();
+    profile(FramePhase::Input);
+    m_recording.uniforms = input();
+
+    if (m_raster)
+    {
+        write_uploads(m_recording);
+        profile(FramePhase::Clear);
+        m_raster->clear(0.2f, 0.3f, 0.3f, 1.0f);
+        profile(FramePhase::Draw);
+        RasterUniforms uniforms{m_recording.uniforms.color_offset, m_recording.uniforms.pos_offset};
+        auto draw_range = [&](const MeshRange &range)
+        {
+            m_frame_stats.draw_calls++;
+            std::span<const std::byte> vertices = m_meshes->cpu_vertices(range);
+            m_raster->draw(uniforms, std::span((const Vec3f *)vertices.data(), range.n_vertices), m_meshes->cpu_elements(range), m_cpu_instances);
+        };
+        if (m_mesh.valid())
+            draw_range(m_mesh_range);
+        else if (m_raster->has_vertices())
+        {
+            m_raster->draw(uniforms, m_cpu_instances);
+            m_frame_stats.draw_calls++;
+        }
+        RenderQueue &queue = m_recording.queue;
+        queue.sort();
+        for (uint32_t index : queue.order())
+        {
+            const DrawItem &item = queue.item(index);
+            uniforms.object = item.object == NO_OBJECT ? OBJECT_IDENTITY : m_recording.objects[item.object];
+            draw_range(item.range);
+        }
+        m_frame_render_stats = RenderQueueStats{queue.size(), 0, 0, 0};
+        queue.clear();
+        m_recording.objects.clear();
+
+        // One pipeline only, programs have nothing to switch
+        for (size_t i = 0; i < m_recording.n_command_lists; i++)
+        {
+            const CommandList &list = m_recording.command_lists[i];
+            MeshRange mesh{};
+            uniforms.object = OBJECT_IDENTITY;
+            list.decode([&](CommandType type, const std::byte *payload)
+                        {
+                            if (type == CommandType::SetObject)
+                                uniforms.object = list.objects()[CommandList::read<uint32_t>(payload)];
+                            else if (type == CommandType::BindMesh)
+                                mesh = CommandList::read<MeshRange>(payload);
+                            else if (type == CommandType::Draw)
+                                draw_range(mesh); });
+            m_frame_stats.bytes_uploaded += list.objects().size_bytes();
+        }
+        m_recording.n_command_lists = 0;
+        uniforms.object = OBJECT_IDENTITY;
+        for (size_t i = 0; i < m_recording.n_dynamic_draws; i++)
+            m_raster->draw(uniforms, m_recording.dynamic_draws[i].cpu_vertices, m_recording.dynamic_draws[i].cpu_elements);
+        m_frame_stats.draw_calls += m_recording.n_dynamic_draws;
+        m_recording.n_dynamic_draws = 0;
+        end_profile();
+        end_frame();
+        return;
+    }
+
+    render(m_recording);
+    profile(FramePhase::Poll);
+    poll_events();
+    end_profile();
+    end_frame();
+}
+
+void App::render(FrameRecording &frame) noexcept
+{
+    write_uploads(frame);
 
     // Background
-    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    profile(FramePhase::Clear);
+    m_gl.clear_color(0.2f, 0.3f, 0.3f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Set color offset according to time
-    float color_offset = ((float)sin(glfwGetTime()) + 1.f) / 2.f; // offset between 0. to 1.
-    float pos_offset = (color_offset / 2.f) - 0.25f;              // offset between -0.25 to 0.25
-    glUniform1f(uniform_location("colorOffset"), color_offset);
-    glUniform1f(uniform_location("posOffset"), pos_offset);
+    // One frame block and one identity object block, next to this frame's object blocks in the ring.
+    // Nothing is in it yet, so it can still grow to hold all of them.
+    profile(FramePhase::Uniforms);
+    size_t n_blocks = frame.objects.size() + 2;
+    for (size_t i = 0; i < frame.n_command_lists; i++)
+        n_blocks += frame.command_lists[i].objects().size();
+    fit_uniforms(n_blocks);
+    size_t frame_offset = write_uniforms(&frame.uniforms, sizeof(frame.uniforms));
+    size_t identity_offset = write_uniforms(&OBJECT_IDENTITY, sizeof(OBJECT_IDENTITY));
+    m_object_offsets.resize(frame.objects.size());
+    for (size_t i = 0; i < frame.objects.size(); i++)
+        m_object_offsets[i] = write_uniforms(&frame.objects[i], sizeof(ObjectUniforms));
+    for (size_t i = 0; i < frame.n_command_lists; i++)
+        for (const ObjectUniforms &object : frame.command_lists[i].objects())
+            m_object_offsets.push_back(write_uniforms(&object, sizeof(object)));
+    m_uniform_ring->flush();
+    m_gl.invalidate_buffer(GL_COPY_WRITE_BUFFER);
+    m_gl.bind_buffer_range(GL_UNIFORM_BUFFER, shaders::FRAME_DATA_BINDING, m_uniform_ring->id(), frame_offset, sizeof(FrameUniforms));
+    m_gl.bind_buffer_range(GL_UNIFORM_BUFFER, shaders::OBJECT_DATA_BINDING, m_uniform_ring->id(), identity_offset, sizeof(ObjectUniforms));
 
     // render vertex
     // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-    glDrawElements(GL_TRIANGLES, m_element_size, GL_UNSIGNED_INT, 0);
+    profile(FramePhase::Draw);
+    unsigned int vao = 0;
+    if (m_va_id)
+    {
+        vao = m_va_id;
+        m_gl.bind_vertex_array(vao);
+        draw_elements(m_element_size, 0, 0);
+    }
+
+    // Registry meshes share one VAO, only the base vertex and index offset change between them
+    if (m_mesh.valid())
+    {
+        vao = m_meshes->vao();
+        m_gl.bind_vertex_array(vao);
+        draw_elements(m_mesh_range.count, m_mesh_range.first_index, m_mesh_range.base_vertex);
+    }
+
+    // Submissions in key order, state is only set when the next draw needs a different one
+    RenderQueue &queue = frame.queue;
+    queue.sort();
+    RenderQueueStats stats{queue.size(), 0, 0, 0};
+    unsigned int program = m_shader_prog;
+    uint32_t material = 0;
+    for (size_t i = 0; i < queue.order().size(); i++)
+    {
+        const DrawItem &item = queue.item(queue.order()[i]);
+        unsigned int item_program = item.program ? item.program : m_shader_prog;
+        if (item_program != program)
+        {
+            program = item_program;
+            stats.program_changes++;
+        }
+        if (item.vao != vao)
+        {
+            vao = item.vao;
+            stats.vao_changes++;
+        }
+        m_gl.use_program(item_program);
+        m_gl.bind_vertex_array(item.vao);
+
+        // Staged blocks were written above
+        size_t object = item.object == NO_OBJECT ? identity_offset : m_object_offsets[item.object];
+        m_gl.bind_buffer_range(GL_UNIFORM_BUFFER, shaders::OBJECT_DATA_BINDING, m_uniform_ring->id(), object, sizeof(ObjectUniforms));
 
-    glfwSwapBuffers(m_window);
-    glfwPollEvents();
-}
\ No newline at end of file
+        // Materials have no GL state yet, the id only groups draws
+        if (i == 0 || item.material != material)
+        {
+            material = item.material;
+            stats.material_changes++;
+        }
+        draw_elements(item.range.count, item.range.first_index, item.range.base_vertex);
+    }
+    m_frame_render_stats = stats;
+    queue.clear();
+    replay(frame, identity_offset);
+    frame.objects.clear();
+    frame.n_command_lists = 0;
+
+    // Back to the default program and identity block, the last queued item or list changed them
+    m_gl.use_program(m_shader_prog);
+    m_gl.bind_buffer_range(GL_UNIFORM_BUFFER, shaders::OBJECT_DATA_BINDING, m_uniform_ring->id(), identity_offset, sizeof(ObjectUniforms));
+
+    // Per-frame geometry from the streaming ring
+    if (frame.n_dynamic_draws)
+    {
+        // Staged ones get their place in the ring now, grown first if they do not fit. Each
+        // allocation may lose up to its alignment.
+        if (m_render_thread)
+        {
+            size_t bytes = 0;
+            for (size_t i = 0; i < frame.n_dynamic_draws; i++)
+            {
+                const DynamicDraw &draw = frame.dynamic_draws[i];
+                bytes += (draw.cpu_vertices.size() + 1) * sizeof(Vec3f) + (draw.cpu_elements.size() + 1) * sizeof(unsigned int);
+            }
+            if (!m_stream || bytes > m_stream->segment_size())
+                reserve_dynamic_geometry(std::max({bytes, DYNAMIC_GEOMETRY_FRAME_BYTES, m_stream ? m_stream->segment_size() * 2 : 0}));
+
+            for (size_t i = 0; i < frame.n_dynamic_draws; i++)
+            {
+                DynamicDraw &draw = frame.dynamic_draws[i];
+                DynamicGeometry geometry = stream_geometry(draw, draw.cpu_vertices.size(), draw.cpu_elements.size());
+                std::copy(draw.cpu_vertices.begin(), draw.cpu_vertices.end(), geometry.vertices.begin());
+                std::copy(draw.cpu_elements.begin(), draw.cpu_elements.end(), geometry.elements.begin());
+                m_frame_stats.bytes_uploaded += geometry.vertices.size_bytes() + geometry.elements.size_bytes();
+            }
+        }
+
+        m_stream->flush();
+        m_gl.bind_vertex_array(m_stream_va_id);
+        for (size_t i = 0; i < frame.n_dynamic_draws; i++)
+        {
+            const DynamicDraw &draw = frame.dynamic_draws[i];
+            glDrawElementsBaseVertex(GL_TRIANGLES, draw.count, GL_UNSIGNED_INT, (void *)draw.index_offset, draw.base_vertex);
+            m_frame_stats.draw_calls++;
+        }
+        m_stream->end_frame();
+        m_gl.invalidate_buffer(GL_COPY_WRITE_BUFFER);
+        frame.n_dynamic_draws = 0;
+    }
+
+    // Fence this frame's uniform blocks
+    m_uniform_ring->end_frame();
+    m_gl.invalidate_buffer(GL_COPY_WRITE_BUFFER);
+
+    // Offscreen frames are not presented, just make sure the GPU keeps up
+    profile(FramePhase::Swap);
+    if (m_mode == AppMode::Headless)
+        glFlush();
+    else
+        m_context.swap_buffers();
+
+    // Swap in a program rebuilt in the background, between frames so that the whole next frame
+    // draws with it. Variants are dropped with their cached files, the next requests rebuild them
+    // from the edited sources.
+    if (m_reloader)
+        if (unsigned int program = m_reloader->poll())
+        {
+            bind_uniform_blocks(program);
+            bind_program(program);
+            for (auto [hash, variant] : m_variants.programs())
+            {
+                m_gl.forget_program(variant);
+                glDeleteProgram(variant);
+            }
+            m_variants.clear();
+        }
+
+    // Same for vertices uploaded in the background, only the newest finished upload is kept
+    if (m_uploader)
+    {
+        UploadService::Buffers buffers, newest{0, 0, 0, 0};
+        while (m_uploader->poll(buffers))
+        {
+            drop_upload(newest);
+            newest = buffers;
+        }
+        if (newest.ticket > m_vertices_done.load(std::memory_order_acquire))
+            adopt_vertices(newest);
+        else
+            drop_upload(newest);
+    }
+}
+
+void App::replay(const FrameRecording &frame, size_t identity_offset) noexcept
+{
+    // Every list starts from the default program and the identity block, the state cache drops
+    // whatever the previous draw already set
+    size_t object_base = frame.objects.size();
+    for (size_t i = 0; i < frame.n_command_lists; i++)
+    {
+        const CommandList &list = frame.command_lists[i];
+        unsigned int program = m_shader_prog;
+        size_t object = identity_offset;
+        MeshRange mesh{};
+        list.decode([&](CommandType type, const std::byte *payload)
+                    {
+                        switch (type)
+                        {
+                        case CommandType::UseProgram:
+                            program = CommandList::read<unsigned int>(payload);
+                            if (!program)
+                                program = m_shader_prog;
+                            break;
+                        case CommandType::SetObject:
+                            object = m_object_offsets[object_base + CommandList::read<uint32_t>(payload)];
+                            break;
+                        case CommandType::BindMesh:
+                            mesh = CommandList::read<MeshRange>(payload);
+                            break;
+                        case CommandType::Draw:
+                            m_gl.use_program(program);
+                            m_gl.bind_vertex_array(m_meshes->vao());
+                            m_gl.bind_buffer_range(GL_UNIFORM_BUFFER, shaders::OBJECT_DATA_BINDING, m_uniform_ring->id(), object, sizeof(ObjectUniforms));
+                            draw_elements(mesh.count, mesh.first_index, mesh.base_vertex);
+                            break;
+                        } });
+        object_base += list.objects().size();
+    }
+}
+
+void App::end_frame() noexcept
+{
+    m_gl.end_frame();
+    m_last_frame_stats = m_frame_stats;
+    m_frame_stats = FrameStats{0, 0};
+    m_render_stats = m_frame_render_stats;
+    if (m_jobs)
+        m_jobs->end_frame();
+    m_frame_index++;
+}
@@ -1,36 +1,406 @@
+#pragma once
+
 #include <GLFW/glfw3.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <span>
 #include <string_view>
+#include <vector>
+
+#include "context.h"
+#include "gl_state.h"
+#include "mesh.h"
+#include "profiler.h"
+#include "program_cache.h"
+#include "render_queue.h"
+#include "shader_bindings.h"
+#include "shader_preprocessor.h"
+#include "trace.h"
+#include "uniform.h"
+#include "upload_scheduler.h"
+#include "upload_service.h"
+#include "vec_math.h"
+#include "vertex_layout.h"
 
-typedef struct
-{
-    float x;
-    float y;
-    float z;
-} Vec3f;
 #define N_VEC3F_COMPONENT 3
 
+using Vec3fLayout = InterleavedLayout<VertexAttrib<VertexSemantic::Position, float, N_VEC3F_COMPONENT>>;
+
+// Per-instance attributes of shaders/vertex.glsl, positions become position * scale + offset
+struct InstanceData
+{
+    float offset[3];
+    float scale;
+    float color[4]; // Multiplies the vertex color, alpha is ignored
+};
+
+using InstanceLayout = InterleavedLayout<VertexAttrib<VertexSemantic::InstanceTransform, float, 4>,
+                                         VertexAttrib<VertexSemantic::InstanceColor, float, 4>>;
+static_assert(sizeof(InstanceData) == InstanceLayout::stride);
+
+// Layouts above feed the locations shaders/vertex.glsl declares
+static_assert(shaders::vertex::A_POS_LOCATION == (unsigned int)VertexSemantic::Position);
+static_assert(shaders::vertex::A_INSTANCE_LOCATION == (unsigned int)VertexSemantic::InstanceTransform);
+static_assert(shaders::vertex::A_INSTANCE_COLOR_LOCATION == (unsigned int)VertexSemantic::InstanceColor);
+
+// What non-instanced draws see
+constexpr InstanceData INSTANCE_IDENTITY = {{0.f, 0.f, 0.f}, 1.f, {1.f, 1.f, 1.f, 1.f}};
+
+// std140 uniform block FrameData of shaders/vertex.glsl
+using FrameUniforms = shaders::FrameData;
+
+// std140 uniform block ObjectData, applied after the instance transform. Splits objectOffset into
+// offset and scale, the generated struct checks the layout.
+struct ObjectUniforms
+{
+    float offset[3];
+    float scale;
+    float color[4]; // Multiplies the vertex color, alpha is ignored
+};
+static_assert(sizeof(ObjectUniforms) == sizeof(shaders::ObjectData));
+static_assert(offsetof(ObjectUniforms, offset) == offsetof(shaders::ObjectData, object_offset));
+static_assert(offsetof(ObjectUniforms, color) == offsetof(shaders::ObjectData, object_color));
+
+constexpr ObjectUniforms OBJECT_IDENTITY = {{0.f, 0.f, 0.f}, 1.f, {1.f, 1.f, 1.f, 1.f}};
+
+// Work of one frame, counted from the end of the previous update() to the end of this one
+struct FrameStats
+{
+    unsigned long draw_calls;
+    size_t bytes_uploaded; // Vertex, index, instance and uniform data handed to the renderer
+};
+
+enum class AppMode
+{
+    Window,   // On-screen GLFW window, presents with glfwSwapBuffers
+    Headless, // Offscreen context rendering into an FBO, no display needed
+    Software, // No GL at all, built-in shaders run on the CPU rasterizer
+};
+
+class CommandList;
+class JobSystem;
+struct JobWorkerStats;
+class Rasterizer;
+class RenderThread;
+class ShaderReloader;
+class StreamBuffer;
+
+// Write pointers for one batch of per-frame geometry, elements index into `vertices`
+struct DynamicGeometry
+{
+    std::span<Vec3f> vertices;
+    std::span<unsigned int> elements;
+};
+
+// Compile and link a program, `cache` may be null
+[[nodiscard]] unsigned int make_program(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info, ProgramCache *cache);
+
 class App
 {
 private:
-    GLFWwindow *m_window;
+    struct DynamicDraw
+    {
+        int base_vertex;
+        size_t index_offset;
+        int count;
+        std::vector<Vec3f> cpu_vertices; // Software backend and render thread only
+        std::vector<unsigned int> cpu_elements;
+    };
+
+    // Draws recorded between two update() calls
+    struct FrameRecording
+    {
+        FrameUniforms uniforms;
+        RenderQueue queue;
+        // Object blocks copied into the ring when drawn, DrawItem::object indexes them
+        std::vector<ObjectUniforms> objects;
+        std::vector<DynamicDraw> dynamic_draws; // Reused across frames to keep their allocations
+        size_t n_dynamic_draws;
+        std::vector<CommandList> command_lists; // Same, replayed after the queue in index order
+        size_t n_command_lists;
+        // Pieces of streamed meshes, written before anything draws
+        std::vector<UploadChunk> upload_chunks;
+        std::vector<std::byte> upload_staging;
+    };
+
+    Context m_context;
+    GlState m_gl;
+    AppMode m_mode;
+    int m_width;
+    int m_height;
+    unsigned int m_fbo;
+    unsigned int m_fbo_color;
+    bool m_should_close;
+    std::chrono::steady_clock::time_point m_start;
+    std::chrono::steady_clock::time_point m_last_update; // Wall clock frame time for the upload budget
+    double m_fixed_step; // Seconds per frame of the simulated clock, 0 for the wall clock
+    unsigned long m_frame_index;
+    FrameStats m_frame_stats;
+    FrameStats m_last_frame_stats;
+    TraceTimeline m_trace_phases; // Frame phases, as the profiler splits them, on the GL thread
+    std::unique_ptr<RenderThread> m_render_thread;
+    std::unique_ptr<JobSystem> m_jobs; // Created on first use
+    std::unique_ptr<Rasterizer> m_raster;
+    std::unique_ptr<FrameProfiler> m_profiler;
+    std::unique_ptr<ProgramCache> m_program_cache;
+    std::unique_ptr<ShaderReloader> m_reloader;
+    std::unique_ptr<UploadService> m_uploader;
+    std::unique_ptr<UploadScheduler> m_streaming;
+    std::atomic<uint64_t> m_vertices_requested; // Newest upload ticket
+    std::atomic<uint64_t> m_vertices_done;      // Newest ticket swapped in or superseded
+    std::unique_ptr<StreamBuffer> m_stream;
+    std::unique_ptr<StreamBuffer> m_uniform_ring;
+    size_t m_uniform_alignment;
+    unsigned int m_stream_va_id;
+    unsigned int m_instance_buffer;
+    size_t m_instance_capacity;
+    size_t m_n_instances;
+    std::vector<InstanceData> m_cpu_instances; // Software backend only
+    std::unique_ptr<MeshRegistry> m_meshes;
+    MeshHandle m_mesh; // Drawn every frame, set by use_vertices
+    MeshRange m_mesh_range;
+    FrameRecording m_recording; // Filled by submit and dynamic_geometry for the next frame
+    FrameRecording m_rendering; // Drawn by the render thread while the next one is recorded
+    std::vector<size_t> m_object_offsets; // Ring offsets of the staged then the command list object blocks being drawn
+    RenderQueueStats m_frame_render_stats;
+    RenderQueueStats m_render_stats;
     unsigned int m_shader_prog;
-    unsigned int m_va_id;
+    UniformTable m_uniforms;
+    ShaderVariantCache m_variants;
+    unsigned int m_va_id; // Own VAO and buffers of use_vertex_data layouts
+    unsigned int m_vb_id;
+    unsigned int m_eb_id;
     int m_element_size;
 
+    [[nodiscard]] double time() const noexcept;
+    void bind_program(unsigned int program) noexcept;
+    // Restored from the program cache or compiled, with the uniform block bindings set
+    [[nodiscard]] unsigned int build_program(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info, uint64_t source_hash);
+    void attach_instances() noexcept;
+    [[nodiscard]] MeshRegistry &meshes();
+    void release_vertices() noexcept;
+    // Drop the background uploads in flight, the caller replaces the vertices itself
+    void supersede_upload() noexcept;
+    void drop_upload(const UploadService::Buffers &buffers) noexcept;
+    [[nodiscard]] UploadScheduler &streaming();
+    // Hand this frame's streaming budget out, on the recording side
+    void schedule_uploads(FrameRecording &frame);
+    void write_uploads(FrameRecording &frame) noexcept;
+    // Own VAO around buffers of the upload service, replacing the current vertices
+    void adopt_vertices(const UploadService::Buffers &buffers) noexcept;
+    void draw_elements(int count, size_t first_index, int base_vertex) noexcept;
+    // Escape key, and the frame block from the clock
+    [[nodiscard]] FrameUniforms input() noexcept;
+    // Everything GL of a frame, from the clear to the swap. Leaves `frame` empty for reuse.
+    void render(FrameRecording &frame) noexcept;
+    // The frame's command lists, their object blocks already in m_object_offsets after the staged ones
+    void replay(const FrameRecording &frame, size_t identity_offset) noexcept;
+    void poll_events() noexcept;
+    // Stats roll-over and the frame counter, while no frame is being drawn
+    void end_frame() noexcept;
+    // True when the caller must hand its GL calls to the render thread
+    [[nodiscard]] bool off_render_thread() const noexcept;
+    // Space for `draw` in this frame's streaming ring segment
+    [[nodiscard]] DynamicGeometry stream_geometry(DynamicDraw &draw, size_t n_vertices, size_t n_elements);
+    // Grow the ring so that a segment holds `n_blocks` uniform blocks, before the frame writes any
+    void fit_uniforms(size_t n_blocks);
+    // Aligned copy of a uniform block into this frame's ring segment, returns its offset
+    [[nodiscard]] size_t write_uniforms(const void *block, size_t size);
+
+    void profile(FramePhase phase) noexcept
+    {
+        TRACE_NEXT(m_trace_phases, frame_phase_name(phase));
+        if (m_profiler)
+            m_profiler->phase(phase);
+    }
+
+    void end_profile() noexcept
+    {
+        TRACE_END(m_trace_phases);
+        if (m_profiler)
+            m_profiler->end_frame();
+    }
+
 public:
-    App(int width, int height, const std::string_view title);
+    App(int width, int height, const std::string_view title, AppMode mode = AppMode::Window);
     ~App();
 
     void use_shaders(const std::span<const char *const> v_info, const std::span<const char *const> f_info);
-    void use_vertices(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements) noexcept;
+    // Sources need not be null terminated, e.g. straight from a MappedFile
+    void use_shaders(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info);
+    // `source_hash` is program_source_hash of the sources, e.g. precomputed for embedded shaders
+    void use_shaders(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info, uint64_t source_hash);
+    // Move the GL context to a thread of its own. update() then only handles input and window
+    // events here and hands the frame over, the render thread draws and swaps it while the next
+    // one is recorded; at most one frame is in flight. submit and dynamic_geometry stay on this
+    // thread, every other GL call is made on the render thread and waits for it. Stats trail by
+    // one frame. No effect on the software backend.
+    void use_render_thread();
+
+    // Rebuild the program in the background whenever a file next to the given sources changes.
+    // Where that cannot be watched, e.g. without inotify, it warns and the program stays as is.
+    void watch_shaders(const std::string_view v_path, const std::string_view f_path);
+    // The mesh drawn every frame, kept in the mesh registry and replacing the previous one
+    void use_vertices(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements);
+    // Same, but uploaded in the background on a shared context: the current vertices are drawn
+    // until the new ones are on the GPU, then swapped in between frames, so a large mesh causes no
+    // hitch. Returns a ticket for vertices_ready(), 0 when there is no GL to upload to. A later
+    // use_vertices* call supersedes an upload still in flight. Throws when the upload thread
+    // cannot get a shared context.
+    [[nodiscard]] uint64_t use_vertices_async(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements);
+    // Whether the upload is drawn or superseded
+    [[nodiscard]] bool vertices_ready(uint64_t ticket) const noexcept
+    {
+        return m_vertices_done.load(std::memory_order_acquire) >= ticket;
+    }
+    [[nodiscard]] UploadStats upload_stats() const noexcept;
+
+    // Meshes suballocated from one shared vertex and index buffer, drawn without any rebind
+    [[nodiscard]] MeshHandle add_mesh(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements);
+    void remove_mesh(MeshHandle mesh);
+    [[nodiscard]] MeshRegistryStats mesh_stats() const noexcept;
+
+    // Like add_mesh, but written over the next frames within the upload budget, lowest priority
+    // first: e.g. the distance to the camera, visible meshes before the rest. The mesh draws
+    // nothing until its last piece is written.
+    [[nodiscard]] MeshHandle stream_mesh(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements, float priority = 0.f);
+    // False when the mesh is no longer streaming
+    bool set_stream_priority(MeshHandle mesh, float priority);
+    [[nodiscard]] bool mesh_ready(MeshHandle mesh);
+    // At most `bytes_per_frame` streamed per frame. With a `frame_target` in seconds the budget
+    // shrinks while frames take longer and grows back while they keep to it, 0 keeps it fixed.
+    void set_upload_budget(size_t bytes_per_frame, double frame_target);
+    [[nodiscard]] UploadSchedulerStats stream_stats() const noexcept;
+
+    // Draw `mesh` in the next update(), after the use_vertices mesh. The frame's submissions are
+    // sorted by render_key, `depth` is the distance to the camera. Instances apply as well.
+    void submit(MeshHandle mesh, float depth = 0.f, uint32_t material = 0, RenderPass pass = RenderPass::Opaque);
+    // Same, with its own ObjectData block copied to the uniform ring when the frame is drawn
+    void submit(MeshHandle mesh, const ObjectUniforms &object, float depth = 0.f, uint32_t material = 0, RenderPass pass = RenderPass::Opaque);
+    // Same, drawn with a shader_variant instead of the use_shaders program
+    void submit(MeshHandle mesh, ShaderVariant variant, float depth = 0.f, uint32_t material = 0, RenderPass pass = RenderPass::Opaque);
+    // `n` empty command lists, replayed in index order after this frame's submissions. Lists are
+    // recorded by any threads in parallel, one thread per list, e.g. a parallel_for chunk each.
+    // Call once per frame; the lists stay valid until update().
+    [[nodiscard]] std::span<CommandList> command_lists(size_t n);
+
+    // Program of the shader files with #includes resolved and `defines` injected, e.g.
+    // {{"INSTANCING", "0"}}. Each unique expanded source compiles once, the App owns the programs.
+    // A watch_shaders reload deletes every variant: request the handles again after it.
+    // The software backend ignores the files and returns program 0.
+    [[nodiscard]] ShaderVariant shader_variant(const std::string_view v_path, const std::string_view f_path, const std::span<const ShaderDefine> defines = {});
+    [[nodiscard]] constexpr const ShaderVariantStats &shader_variant_stats() const noexcept
+    {
+        return m_variants.stats();
+    }
+
+    // Size the per-frame uniform ring, the default holds UNIFORM_RING_FRAME_BYTES per frame. It
+    // grows on its own when a frame has more blocks than that.
+    void reserve_uniforms(size_t bytes_per_frame);
+
+    // Animate from frame_index * step instead of the wall clock, so every run renders the same
+    // frames. 0 goes back to the wall clock.
+    void use_fixed_clock(double step) noexcept;
+    [[nodiscard]] constexpr const FrameStats &frame_stats() const noexcept
+    {
+        return m_last_frame_stats;
+    }
+
+    // State changes of the last frame's submissions
+    [[nodiscard]] constexpr const RenderQueueStats &render_stats() const noexcept
+    {
+        return m_render_stats;
+    }
+
+    // Size the per-frame streaming ring, the default holds DYNAMIC_GEOMETRY_FRAME_BYTES per frame.
+    // With a render thread it grows on its own to hold a frame's staged geometry.
+    void reserve_dynamic_geometry(size_t bytes_per_frame);
+
+    // Geometry drawn by the next update() only. Write straight into the spans, they point into
+    // GPU visible memory and are valid until update().
+    [[nodiscard]] DynamicGeometry dynamic_geometry(size_t n_vertices, size_t n_elements);
+
+    // Vertex data described by `attribs`, streams[i] holds every attribute with stream == i.
+    // Any layout, so it gets its own VAO and buffers instead of a registry mesh.
+    void use_vertex_data(const std::span<const VertexAttribDesc> attribs, const std::span<const std::span<const std::byte>> streams, const std::span<const unsigned int> elements);
+
+    // Interleaved vertices, Vertex must be laid out like the Layout
+    template <typename Layout, typename Vertex>
+    void use_vertices(const std::span<const Vertex> vertices, const std::span<const unsigned int> elements)
+    {
+        static_assert(Layout::interleaved, "use_vertex_streams takes separate layouts");
+        static_assert(sizeof(Vertex) == Layout::stride, "Vertex does not match the layout");
+        const std::span<const std::byte> streams[] = {std::as_bytes(vertices)};
+        use_vertex_data(Layout::attribs, streams, elements);
+    }
+
+    // One stream per attribute, in layout order
+    template <typename Layout, typename... Streams>
+    void use_vertex_streams(const std::span<const unsigned int> elements, const std::span<const Streams>... streams)
+    {
+        static_assert(!Layout::interleaved, "use_vertices takes interleaved layouts");
+        static_assert(Layout::template matches<Streams...>(), "Streams do not match the layout");
+        const std::span<const std::byte> bytes[] = {std::as_bytes(streams)...};
+        use_vertex_data(Layout::attribs, bytes, elements);
+    }
+
+    // Draw the mesh once per instance with a single instanced call, an empty span goes back to one
+    // plain draw. The buffer only grows, geometrically, so per-frame calls reuse its storage.
+    void use_instances(const std::span<const InstanceData> instances);
+
+    // Overwrite instances [first, first + size) in place
+    void update_instances(size_t first, const std::span<const InstanceData> instances);
+
+    [[nodiscard]] constexpr size_t n_instances() const noexcept
+    {
+        return m_n_instances;
+    }
+
     void update() noexcept;
 
+    // Resolved from the table built when the program was linked, no driver call
     [[nodiscard]] int uniform_location(const char *key) noexcept;
+    [[nodiscard]] int uniform_location(UniformKey key) noexcept;
+
+    [[nodiscard]] constexpr const UniformTable &uniforms() const noexcept
+    {
+        return m_uniforms;
+    }
+
+    // GL calls of the last frame that went through vs. were skipped as redundant
+    [[nodiscard]] constexpr const GlStateStats &gl_state_stats() const noexcept
+    {
+        return m_gl.last_frame();
+    }
+
+    // Program binary cache hits vs. full compiles done by use_shaders
+    [[nodiscard]] ProgramCacheStats program_cache_stats() const noexcept;
+
+    // Start recording per phase CPU times and, when a GL context exists, GPU frame times
+    void enable_profiler();
+
+    // Waits for the frame in flight, the render thread writes to it
+    [[nodiscard]] const FrameProfiler *profiler() const noexcept;
+
+    // Job system for per-frame CPU work, one worker per hardware thread. The thread calling this
+    // first, normally the one calling update(), is its worker 0 and the only one that may queue
+    // jobs besides the workers themselves.
+    [[nodiscard]] JobSystem &jobs();
+    // Per worker job counts and utilization of the last frame, empty before jobs() was called
+    [[nodiscard]] std::span<const JobWorkerStats> job_stats() const noexcept;
+
+    // Read back the current frame as tightly packed RGBA8 rows, bottom row first
+    [[nodiscard]] std::vector<unsigned char> read_pixels() const;
 
     [[nodiscard]] constexpr GLFWwindow *window() noexcept
     {
-        return m_window;
+        return m_context.window();
+    }
+
+    [[nodiscard]] constexpr AppMode mode() const noexcept
+    {
+        return m_mode;
     }
 
     [[nodiscard]] constexpr unsigned int shader_prog() noexcept
@@ -38,5 +408,6 @@ public:
         return m_shader_prog;
     }
 
+    void close() noexcept;
     [[nodiscard]] bool done() noexcept;
 };
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <format>
+#include <future>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "asset.h"
+#include "trace.h"
+
+MappedFile::MappedFile(const std::string_view path)
+    : m_data(nullptr), m_size(0)
+{
+    TRACE_SCOPE("map_file");
+    const std::string path_str(path);
+    int fd = open(path_str.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error(std::format("Failed to open {}", path_str));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        throw std::runtime_error(std::format("Failed to stat {}", path_str));
+    }
+
+    // mmap refuses empty ranges, an empty file is just an empty span
+    m_size = st.st_size;
+    if (m_size > 0)
+    {
+        m_data = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (m_data == MAP_FAILED)
+        {
+            m_data = nullptr;
+            close(fd);
+            throw std::runtime_error(std::format("Failed to map {}", path_str));
+        }
+        madvise(m_data, m_size, MADV_SEQUENTIAL);
+    }
+
+    // The mapping keeps the file alive
+    close(fd);
+}
+
+MappedFile::MappedFile(MappedFile &&other) noexcept
+    : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0))
+{
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        this->~MappedFile();
+        new (this) MappedFile(std::move(other));
+    }
+    return *this;
+}
+
+MappedFile::~MappedFile()
+{
+    if (m_data)
+        munmap(m_data, m_size);
+}
+
+void MappedFile::populate() const noexcept
+{
+    if (!m_data)
+        return;
+    TRACE_SCOPE("populate");
+
+    // Let the kernel read ahead, then touch every page so nothing faults on the GL thread
+    madvise(m_data, m_size, MADV_WILLNEED);
+    size_t page = sysconf(_SC_PAGESIZE);
+    volatile char sink = 0;
+    for (size_t offset = 0; offset < m_size; offset += page)
+        sink = sink + ((const volatile char *)m_data)[offset];
+}
+
+void AssetLoader::prefetch(const std::string_view path)
+{
+    if (m_files.contains(path) || m_pending.contains(path))
+        return;
+
+    m_pending.emplace(std::string(path), std::async(std::launch::async, [path = std::string(path)]
+                                                    {
+                                                        TRACE_THREAD_NAME("asset prefetch");
+                                                        auto file = std::make_unique<MappedFile>(path);
+                                                        file->populate();
+                                                        return file; }));
+}
+
+const MappedFile &AssetLoader::get(const std::string_view path)
+{
+    if (auto it = m_files.find(path); it != m_files.end())
+        return *it->second;
+
+    // Errors of the prefetch thread are rethrown here
+    std::unique_ptr<MappedFile> file;
+    if (auto it = m_pending.find(path); it != m_pending.end())
+    {
+        auto pending = std::move(it->second);
+        m_pending.erase(it);
+        file = pending.get();
+    }
+    else
+    {
+        file = std::make_unique<MappedFile>(path);
+    }
+
+    return *m_files.emplace(std::string(path), std::move(file)).first->second;
+}
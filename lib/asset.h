@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+// Read-only mapping of a whole file, spans handed out point straight into it
+class MappedFile
+{
+private:
+    void *m_data;
+    size_t m_size;
+
+public:
+    explicit MappedFile(const std::string_view path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    MappedFile(MappedFile &&other) noexcept;
+    MappedFile &operator=(MappedFile &&other) noexcept;
+    ~MappedFile();
+
+    // Fault every page in, blocks until the file is resident
+    void populate() const noexcept;
+
+    [[nodiscard]] std::span<const char> bytes() const noexcept
+    {
+        return {(const char *)m_data, m_size};
+    }
+
+    [[nodiscard]] std::string_view text() const noexcept
+    {
+        return {(const char *)m_data, m_size};
+    }
+
+    // View the file as an array of T, e.g. Vec3f positions for App::use_vertices
+    template <typename T>
+    [[nodiscard]] std::span<const T> as() const
+    {
+        if (m_size % sizeof(T) != 0 || (uintptr_t)m_data % alignof(T) != 0)
+            throw std::runtime_error("File is not an array of the requested type");
+        return {(const T *)m_data, m_size / sizeof(T)};
+    }
+};
+
+// Owns the mappings of every asset loaded through it
+class AssetLoader
+{
+private:
+    std::map<std::string, std::future<std::unique_ptr<MappedFile>>, std::less<>> m_pending;
+    std::map<std::string, std::unique_ptr<MappedFile>, std::less<>> m_files;
+
+public:
+    AssetLoader() = default;
+    AssetLoader(const AssetLoader &) = delete;
+    AssetLoader &operator=(const AssetLoader &) = delete;
+
+    // Start mapping and paging in the file on a background thread, returns immediately
+    void prefetch(const std::string_view path);
+
+    // Waits for a pending prefetch, or maps the file now. Valid as long as the loader.
+    [[nodiscard]] const MappedFile &get(const std::string_view path);
+};
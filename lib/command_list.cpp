@@ -0,0 +1,50 @@
+#include <cstdint>
+#include <stdexcept>
+
+#include "command_list.h"
+
+CommandList::CommandList(const MeshRegistry *meshes) noexcept
+    : m_meshes(meshes), m_mesh_bound(false)
+{
+}
+
+void CommandList::use_program(unsigned int program)
+{
+    write(CommandType::UseProgram, program);
+}
+
+void CommandList::use_program(ShaderVariant variant)
+{
+    use_program(variant.program);
+}
+
+void CommandList::set_object(const ObjectUniforms &object)
+{
+    write(CommandType::SetObject, (uint32_t)m_objects.size());
+    m_objects.push_back(object);
+}
+
+void CommandList::bind_mesh(MeshHandle mesh)
+{
+    if (!m_meshes)
+        throw std::runtime_error("Command list has no mesh registry");
+
+    // Resolved now, the replay only sees plain ranges
+    write(CommandType::BindMesh, m_meshes->range(mesh));
+    m_mesh_bound = true;
+}
+
+void CommandList::draw()
+{
+    if (!m_mesh_bound)
+        throw std::runtime_error("Command list draw without a bound mesh");
+
+    write(CommandType::Draw);
+}
+
+void CommandList::clear() noexcept
+{
+    m_commands.clear();
+    m_objects.clear();
+    m_mesh_bound = false;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "app.h"
+#include "mesh.h"
+#include "shader_preprocessor.h"
+
+enum class CommandType : uint32_t
+{
+    UseProgram, // unsigned int, 0 for the App's program
+    SetObject,  // uint32_t index of the list's object block
+    BindMesh,   // MeshRange of a registry mesh
+    Draw,       // No payload, the bound mesh with the current program and object block
+};
+
+// Draw commands recorded on any thread and replayed in order on the GL thread by App. Commands are
+// a header and a fixed payload appended to one linear buffer; object blocks are kept aside so they
+// can go to the uniform ring before the draws. clear() keeps the memory, a list reused every frame
+// stops allocating once it reached its largest frame.
+class CommandList
+{
+public:
+    struct Header
+    {
+        CommandType type;
+        uint32_t size; // Payload bytes following the header
+    };
+
+private:
+    const MeshRegistry *m_meshes;
+    std::vector<std::byte> m_commands;
+    std::vector<ObjectUniforms> m_objects;
+    bool m_mesh_bound;
+
+    void write(CommandType type)
+    {
+        Header header{type, 0};
+        size_t at = m_commands.size();
+        m_commands.resize(at + sizeof(header));
+        memcpy(m_commands.data() + at, &header, sizeof(header));
+    }
+
+    template <typename T>
+    void write(CommandType type, const T &payload)
+    {
+        Header header{type, sizeof(T)};
+        size_t at = m_commands.size();
+        m_commands.resize(at + sizeof(header) + sizeof(T));
+        memcpy(m_commands.data() + at, &header, sizeof(header));
+        memcpy(m_commands.data() + at + sizeof(header), &payload, sizeof(T));
+    }
+
+public:
+    // Meshes are resolved against `meshes` when recorded
+    explicit CommandList(const MeshRegistry *meshes = nullptr) noexcept;
+
+    void use_program(unsigned int program);
+    void use_program(ShaderVariant variant);
+    void set_object(const ObjectUniforms &object);
+    void bind_mesh(MeshHandle mesh);
+    void draw();
+    void clear() noexcept;
+
+    // f(type, payload) for every command in record order
+    template <typename F>
+    void decode(F &&f) const
+    {
+        const std::byte *at = m_commands.data(), *end = at + m_commands.size();
+        while (at < end)
+        {
+            Header header;
+            memcpy(&header, at, sizeof(header));
+            f(header.type, at + sizeof(header));
+            at += sizeof(header) + header.size;
+        }
+    }
+
+    // Copy of a command's payload, `payload` as passed to decode's callback
+    template <typename T>
+    [[nodiscard]] static T read(const std::byte *payload) noexcept
+    {
+        T value;
+        memcpy(&value, payload, sizeof(T));
+        return value;
+    }
+
+    [[nodiscard]] std::span<const ObjectUniforms> objects() const noexcept
+    {
+        return m_objects;
+    }
+
+    [[nodiscard]] bool empty() const noexcept
+    {
+        return m_commands.empty();
+    }
+};
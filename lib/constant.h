@@ -1,4 +1,28 @@
+#pragma once
+
+#include <cstddef>
+
 constexpr int APP_GLFW_CTX_VER_MAJOR = 3;
 constexpr int APP_GLFW_CTX_VER_MINOR = 3;
 constexpr int GL_STACK_ERR_BUF_LEN = 1024;
-#define WIN_TITLE "LearnOpenGl"
\ No newline at end of file
+constexpr int GL_UNIFORM_NAME_BUF_LEN = 256;
+constexpr int RASTER_TILE_SIZE = 32;
+constexpr int PROFILER_HISTORY = 1024;
+constexpr int PROFILER_QUERY_RING = 4;
+constexpr int SHADER_RELOAD_DEBOUNCE_MS = 50;
+constexpr size_t STREAM_BUFFER_ALIGNMENT = 256;
+constexpr unsigned long STREAM_BUFFER_WAIT_NS = 100000000;
+constexpr size_t DYNAMIC_GEOMETRY_FRAME_BYTES = 4 << 20;
+constexpr size_t MESH_REGISTRY_VERTICES = 1 << 16;
+constexpr size_t MESH_REGISTRY_INDICES = 1 << 18;
+constexpr int GL_STATE_MAX_UNIFORM_LOCATION = 1024;
+constexpr size_t UNIFORM_RING_FRAME_BYTES = 1 << 20;
+constexpr size_t TRACE_BUFFER_EVENTS = 1 << 16;
+constexpr size_t RENDER_THREAD_COMMANDS = 64;
+constexpr size_t JOB_POOL_SIZE = 4096;
+constexpr size_t UPLOAD_SLICE_BYTES = 1 << 20;
+constexpr size_t UPLOAD_FRAME_BUDGET_BYTES = 4 << 20;
+constexpr size_t UPLOAD_MIN_BUDGET_BYTES = 64 << 10;
+constexpr double UPLOAD_FRAME_TARGET = 1. / 60.;
+#define WIN_TITLE "LearnOpenGl"
+#define PROGRAM_CACHE_DIR ".shader_cache"
\ No newline at end of file
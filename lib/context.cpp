@@ -0,0 +1,282 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#ifndef __APPLE__
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+#include <new>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+
+#include "context.h"
+#include "constant.h"
+#include "trace.h"
+
+// Number of live GLFW windows, glfw is terminated with the last one
+static int g_glfw_users = 0;
+
+static void glfw_acquire()
+{
+    TRACE_SCOPE("glfwInit");
+    if (g_glfw_users == 0 && !glfwInit())
+        throw std::runtime_error("Failed to initialize GLFW");
+    g_glfw_users++;
+}
+
+static void glfw_release() noexcept
+{
+    if (--g_glfw_users == 0)
+        glfwTerminate();
+}
+
+static void glfw_context_hints(bool visible)
+{
+    glfwDefaultWindowHints();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, APP_GLFW_CTX_VER_MAJOR);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, APP_GLFW_CTX_VER_MINOR);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+}
+
+static GLFWwindow *glfw_make_window(int width, int height, const char *title, bool visible, GLFWwindow *share)
+{
+    glfw_acquire();
+    glfw_context_hints(visible);
+    TRACE_SCOPE("glfwCreateWindow");
+    GLFWwindow *window = glfwCreateWindow(width, height, title, NULL, share);
+    if (window == NULL)
+    {
+        glfw_release();
+        throw std::runtime_error("Failed to create GLFW window");
+    }
+    return window;
+}
+
+static void *glfw_loader(const char *name)
+{
+    return (void *)glfwGetProcAddress(name);
+}
+
+#ifndef __APPLE__
+static void *egl_loader(const char *name)
+{
+    return (void *)eglGetProcAddress(name);
+}
+
+static EGLDisplay egl_get_display()
+{
+    TRACE_SCOPE("eglInitialize");
+
+    // Prefer a display that needs neither X11 nor a DRM device
+    const char *client_ext = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (client_ext && std::string_view(client_ext).find("EGL_MESA_platform_surfaceless") != std::string_view::npos)
+    {
+        auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display)
+        {
+            EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL))
+                return display;
+        }
+    }
+
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+        return EGL_NO_DISPLAY;
+    return display;
+}
+
+// Returns false when the display only supports surfaceless contexts
+static bool egl_choose_config(EGLDisplay display, EGLConfig *config)
+{
+    const EGLint attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE};
+    EGLint n_config = 0;
+    return eglChooseConfig(display, attribs, config, 1, &n_config) && n_config > 0;
+}
+
+static bool egl_make_context(EGLDisplay display, EGLContext share, EGLContext *context, EGLSurface *surface)
+{
+    TRACE_SCOPE("eglCreateContext");
+    if (!eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    EGLConfig config = NULL;
+    bool has_config = egl_choose_config(display, &config);
+
+    const EGLint ctx_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, APP_GLFW_CTX_VER_MAJOR,
+        EGL_CONTEXT_MINOR_VERSION, APP_GLFW_CTX_VER_MINOR,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    *context = eglCreateContext(display, has_config ? config : EGL_NO_CONFIG_KHR, share, ctx_attribs);
+    if (*context == EGL_NO_CONTEXT)
+        return false;
+
+    // Rendering goes to an FBO, the pbuffer only exists to make the context current
+    *surface = EGL_NO_SURFACE;
+    if (has_config)
+    {
+        const EGLint pb_attribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+        *surface = eglCreatePbufferSurface(display, config, pb_attribs);
+    }
+    return true;
+}
+#endif
+
+Context::Context() noexcept
+    : m_window(nullptr), m_egl_display(nullptr), m_egl_context(nullptr), m_egl_surface(nullptr), m_owns_display(false)
+{
+}
+
+Context::Context(int width, int height, const std::string_view title)
+    : Context()
+{
+    m_window = glfw_make_window(width, height, title.data(), true, NULL);
+}
+
+Context Context::headless(int width, int height)
+{
+    Context ctx;
+
+#ifndef __APPLE__
+    // Try EGL first, works without a display server (e.g. Mesa llvmpipe)
+    EGLDisplay display = egl_get_display();
+    if (display != EGL_NO_DISPLAY)
+    {
+        EGLContext context;
+        EGLSurface surface;
+        if (egl_make_context(display, EGL_NO_CONTEXT, &context, &surface))
+        {
+            ctx.m_egl_display = display;
+            ctx.m_egl_context = context;
+            ctx.m_egl_surface = surface;
+            ctx.m_owns_display = true;
+            return ctx;
+        }
+        eglTerminate(display);
+    }
+#endif
+
+    // Fall back to a hidden window
+    ctx.m_window = glfw_make_window(width, height, "", false, NULL);
+    return ctx;
+}
+
+Context::Context(Context &&other) noexcept
+    : m_window(std::exchange(other.m_window, nullptr)),
+      m_egl_display(std::exchange(other.m_egl_display, nullptr)),
+      m_egl_context(std::exchange(other.m_egl_context, nullptr)),
+      m_egl_surface(std::exchange(other.m_egl_surface, nullptr)),
+      m_owns_display(std::exchange(other.m_owns_display, false))
+{
+}
+
+Context &Context::operator=(Context &&other) noexcept
+{
+    if (this != &other)
+    {
+        this->~Context();
+        new (this) Context(std::move(other));
+    }
+    return *this;
+}
+
+Context::~Context()
+{
+    if (m_window)
+    {
+        glfwDestroyWindow(m_window);
+        glfw_release();
+    }
+
+#ifndef __APPLE__
+    if (m_egl_context)
+    {
+        if (eglGetCurrentContext() == m_egl_context)
+            eglMakeCurrent(m_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        if (m_egl_surface)
+            eglDestroySurface(m_egl_display, m_egl_surface);
+        eglDestroyContext(m_egl_display, m_egl_context);
+        if (m_owns_display)
+            eglTerminate(m_egl_display);
+    }
+#endif
+}
+
+Context Context::make_shared() const
+{
+    Context ctx;
+
+#ifndef __APPLE__
+    if (is_egl())
+    {
+        EGLContext context;
+        EGLSurface surface;
+        if (!egl_make_context(m_egl_display, m_egl_context, &context, &surface))
+            throw std::runtime_error("Failed to create shared EGL context");
+        ctx.m_egl_display = m_egl_display;
+        ctx.m_egl_context = context;
+        ctx.m_egl_surface = surface;
+        return ctx;
+    }
+#endif
+
+    ctx.m_window = glfw_make_window(1, 1, "", false, m_window);
+    return ctx;
+}
+
+void Context::make_current() const
+{
+#ifndef __APPLE__
+    if (is_egl())
+    {
+        // The bound API is per thread
+        eglBindAPI(EGL_OPENGL_API);
+        if (!eglMakeCurrent(m_egl_display, m_egl_surface, m_egl_surface, m_egl_context))
+            throw std::runtime_error("Failed to make EGL context current");
+        return;
+    }
+#endif
+
+    glfwMakeContextCurrent(m_window);
+}
+
+void Context::release() const noexcept
+{
+#ifndef __APPLE__
+    if (is_egl())
+    {
+        eglMakeCurrent(m_egl_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        return;
+    }
+#endif
+
+    glfwMakeContextCurrent(NULL);
+}
+
+void Context::swap_buffers() const noexcept
+{
+    if (m_window)
+        glfwSwapBuffers(m_window);
+}
+
+ContextProcLoader Context::loader() const noexcept
+{
+#ifndef __APPLE__
+    if (is_egl())
+        return egl_loader;
+#endif
+
+    return glfw_loader;
+}
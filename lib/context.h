@@ -0,0 +1,51 @@
+#pragma once
+
+#include <GLFW/glfw3.h>
+#include <string_view>
+
+typedef void *(*ContextProcLoader)(const char *name);
+
+class Context
+{
+private:
+    GLFWwindow *m_window;
+    void *m_egl_display;
+    void *m_egl_context;
+    void *m_egl_surface;
+    bool m_owns_display;
+
+public:
+    // No context at all, for the CPU rendering backend
+    Context() noexcept;
+
+    // Visible GLFW window with its own context
+    Context(int width, int height, const std::string_view title);
+
+    // Offscreen context (EGL pbuffer/surfaceless, hidden GLFW window as fallback)
+    [[nodiscard]] static Context headless(int width, int height);
+
+    Context(const Context &) = delete;
+    Context &operator=(const Context &) = delete;
+    Context(Context &&other) noexcept;
+    Context &operator=(Context &&other) noexcept;
+    ~Context();
+
+    // Hidden context sharing objects with this one, for use on another thread
+    [[nodiscard]] Context make_shared() const;
+
+    void make_current() const;
+    void release() const noexcept;
+    void swap_buffers() const noexcept;
+
+    [[nodiscard]] ContextProcLoader loader() const noexcept;
+
+    [[nodiscard]] constexpr GLFWwindow *window() const noexcept
+    {
+        return m_window;
+    }
+
+    [[nodiscard]] constexpr bool is_egl() const noexcept
+    {
+        return m_egl_context != nullptr;
+    }
+};
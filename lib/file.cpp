@@ -0,0 +1,24 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+#include "file.h"
+#include "trace.h"
+
+std::string read_file(const std::string_view file_name)
+{
+    TRACE_SCOPE("read_file");
+
+    // Check for size
+    auto size = std::filesystem::file_size(file_name);
+
+    // Reserve buffer
+    std::string retval(size, '\0');
+
+    // Read file
+    std::ifstream in(file_name.data());
+    in.read(retval.data(), size);
+
+    return retval;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+[[nodiscard]] std::string read_file(const std::string_view file_name);
@@ -0,0 +1,43 @@
+#include <glad/glad.h>
+#include <string_view>
+
+#include "gl_ext.h"
+
+PFNGLGETPROGRAMBINARYPROC gl_ext_get_program_binary = nullptr;
+PFNGLPROGRAMBINARYPROC gl_ext_program_binary = nullptr;
+PFNGLPROGRAMPARAMETERIPROC gl_ext_program_parameteri = nullptr;
+PFNGLBUFFERSTORAGEPROC gl_ext_buffer_storage = nullptr;
+
+bool gl_has_extension(std::string_view name) noexcept
+{
+    int n_extensions = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &n_extensions);
+    for (int i = 0; i < n_extensions; i++)
+    {
+        const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+        if (extension && name == extension)
+            return true;
+    }
+    return false;
+}
+
+bool gl_version_at_least(int major, int minor) noexcept
+{
+    int ctx_major = 0, ctx_minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &ctx_major);
+    glGetIntegerv(GL_MINOR_VERSION, &ctx_minor);
+    return ctx_major > major || (ctx_major == major && ctx_minor >= minor);
+}
+
+void gl_ext_load(ContextProcLoader loader)
+{
+    if (gl_version_at_least(4, 1) || gl_has_extension("GL_ARB_get_program_binary"))
+    {
+        gl_ext_get_program_binary = (PFNGLGETPROGRAMBINARYPROC)loader("glGetProgramBinary");
+        gl_ext_program_binary = (PFNGLPROGRAMBINARYPROC)loader("glProgramBinary");
+        gl_ext_program_parameteri = (PFNGLPROGRAMPARAMETERIPROC)loader("glProgramParameteri");
+    }
+
+    if (gl_version_at_least(4, 4) || gl_has_extension("GL_ARB_buffer_storage"))
+        gl_ext_buffer_storage = (PFNGLBUFFERSTORAGEPROC)loader("glBufferStorage");
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <string_view>
+
+#include "context.h"
+
+// Entry points and enums beyond the GL 3.3 core profile glad was generated for.
+// Pointers stay null when neither the GL version nor the extension provides them.
+
+// GL 4.1 / ARB_get_program_binary
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+typedef void(APIENTRYP PFNGLGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize, GLsizei *length, GLenum *binaryFormat, void *binary);
+typedef void(APIENTRYP PFNGLPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat, const void *binary, GLsizei length);
+typedef void(APIENTRYP PFNGLPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+extern PFNGLGETPROGRAMBINARYPROC gl_ext_get_program_binary;
+extern PFNGLPROGRAMBINARYPROC gl_ext_program_binary;
+extern PFNGLPROGRAMPARAMETERIPROC gl_ext_program_parameteri;
+
+// GL 4.4 / ARB_buffer_storage
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+typedef void(APIENTRYP PFNGLBUFFERSTORAGEPROC)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+extern PFNGLBUFFERSTORAGEPROC gl_ext_buffer_storage;
+
+// Needs a current context
+void gl_ext_load(ContextProcLoader loader);
+
+[[nodiscard]] bool gl_has_extension(std::string_view name) noexcept;
+[[nodiscard]] bool gl_version_at_least(int major, int minor) noexcept;
@@ -0,0 +1,279 @@
+#include <glad/glad.h>
+#include <bit>
+#include <cstdint>
+
+#include "gl_state.h"
+#include "constant.h"
+
+// Shadowed enums, anything else passes straight through
+static constexpr GLenum BUFFER_TARGETS[] = {GL_ARRAY_BUFFER, GL_ELEMENT_ARRAY_BUFFER, GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                            GL_PIXEL_PACK_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_TEXTURE_BUFFER, GL_UNIFORM_BUFFER};
+static constexpr GLenum TEXTURE_TARGETS[] = {GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP, GL_TEXTURE_2D_ARRAY, GL_TEXTURE_3D};
+static constexpr GLenum CAPABILITIES[] = {GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST};
+
+template <size_t N>
+static int enum_index(const GLenum (&table)[N], GLenum value) noexcept
+{
+    for (size_t i = 0; i < N; i++)
+        if (table[i] == value)
+            return i;
+    return -1;
+}
+
+GlState::GlState()
+    : m_program_uniforms(nullptr), m_frame{0, 0}, m_last_frame{0, 0}
+{
+    invalidate();
+}
+
+void GlState::invalidate() noexcept
+{
+    m_program = UNKNOWN;
+    m_program_uniforms = nullptr;
+    m_vao = UNKNOWN;
+    m_buffers.fill(UNKNOWN);
+    m_uniform_ranges.fill(BufferRange{UNKNOWN, 0, 0});
+    m_active_texture = UNKNOWN;
+    for (auto &unit : m_textures)
+        unit.fill(UNKNOWN);
+    m_capabilities.fill(-1);
+    m_blend_src = m_blend_dst = UNKNOWN;
+    m_depth_func = UNKNOWN;
+    m_depth_mask = -1;
+    m_clear_color_known = false;
+}
+
+void GlState::invalidate_buffer(unsigned int target) noexcept
+{
+    int index = enum_index(BUFFER_TARGETS, target);
+    if (index >= 0)
+        m_buffers[index] = UNKNOWN;
+}
+
+void GlState::forget_program(unsigned int program) noexcept
+{
+    if (m_program == program)
+    {
+        m_program = UNKNOWN;
+        m_program_uniforms = nullptr;
+    }
+    m_uniforms.erase(program);
+}
+
+void GlState::forget_vertex_array(unsigned int vao) noexcept
+{
+    if (m_vao == vao)
+        bind_vertex_array(0);
+}
+
+void GlState::forget_buffer(unsigned int buffer) noexcept
+{
+    for (auto &bound : m_buffers)
+        if (bound == buffer)
+            bound = UNKNOWN;
+    for (auto &range : m_uniform_ranges)
+        if (range.buffer == buffer)
+            range.buffer = UNKNOWN;
+}
+
+void GlState::forget_texture(unsigned int texture) noexcept
+{
+    for (auto &unit : m_textures)
+        for (auto &bound : unit)
+            if (bound == texture)
+                bound = UNKNOWN;
+}
+
+void GlState::use_program(unsigned int program) noexcept
+{
+    if (skip(m_program == program))
+        return;
+
+    glUseProgram(program);
+    m_program = program;
+    m_program_uniforms = program ? &m_uniforms[program] : nullptr;
+}
+
+void GlState::bind_vertex_array(unsigned int vao) noexcept
+{
+    if (skip(m_vao == vao))
+        return;
+
+    glBindVertexArray(vao);
+    m_vao = vao;
+    m_buffers[enum_index(BUFFER_TARGETS, GL_ELEMENT_ARRAY_BUFFER)] = UNKNOWN;
+}
+
+void GlState::bind_buffer(unsigned int target, unsigned int buffer) noexcept
+{
+    int index = enum_index(BUFFER_TARGETS, target);
+    if (skip(index >= 0 && m_buffers[index] == buffer))
+        return;
+
+    glBindBuffer(target, buffer);
+    if (index >= 0)
+        m_buffers[index] = buffer;
+}
+
+void GlState::bind_buffer_range(unsigned int target, unsigned int index, unsigned int buffer, size_t offset, size_t size) noexcept
+{
+    bool shadowed = target == GL_UNIFORM_BUFFER && index < (unsigned int)N_UNIFORM_BINDINGS;
+    if (skip(shadowed && m_uniform_ranges[index].buffer == buffer && m_uniform_ranges[index].offset == offset && m_uniform_ranges[index].size == size))
+        return;
+
+    // Also binds the generic target
+    glBindBufferRange(target, index, buffer, offset, size);
+    int generic = enum_index(BUFFER_TARGETS, target);
+    if (generic >= 0)
+        m_buffers[generic] = buffer;
+    if (shadowed)
+        m_uniform_ranges[index] = BufferRange{buffer, offset, size};
+}
+
+void GlState::bind_texture(unsigned int unit, unsigned int target, unsigned int texture) noexcept
+{
+    int index = enum_index(TEXTURE_TARGETS, target);
+    if (index < 0 || unit >= (unsigned int)N_TEXTURE_UNITS)
+    {
+        m_frame.issued++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        m_active_texture = unit;
+        return;
+    }
+    if (skip(m_textures[unit][index] == texture))
+        return;
+
+    if (m_active_texture != unit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_active_texture = unit;
+    }
+    glBindTexture(target, texture);
+    m_textures[unit][index] = texture;
+}
+
+void GlState::set_capability(unsigned int capability, bool enabled) noexcept
+{
+    int index = enum_index(CAPABILITIES, capability);
+    if (skip(index >= 0 && m_capabilities[index] == (int)enabled))
+        return;
+
+    if (enabled)
+        glEnable(capability);
+    else
+        glDisable(capability);
+    if (index >= 0)
+        m_capabilities[index] = enabled;
+}
+
+void GlState::blend_func(unsigned int src, unsigned int dst) noexcept
+{
+    if (skip(m_blend_src == src && m_blend_dst == dst))
+        return;
+
+    glBlendFunc(src, dst);
+    m_blend_src = src;
+    m_blend_dst = dst;
+}
+
+void GlState::depth_func(unsigned int func) noexcept
+{
+    if (skip(m_depth_func == func))
+        return;
+
+    glDepthFunc(func);
+    m_depth_func = func;
+}
+
+void GlState::depth_mask(bool write) noexcept
+{
+    if (skip(m_depth_mask == (int)write))
+        return;
+
+    glDepthMask(write);
+    m_depth_mask = write;
+}
+
+void GlState::clear_color(float r, float g, float b, float a) noexcept
+{
+    std::array<uint32_t, 4> bits = {std::bit_cast<uint32_t>(r), std::bit_cast<uint32_t>(g), std::bit_cast<uint32_t>(b), std::bit_cast<uint32_t>(a)};
+    if (skip(m_clear_color_known && m_clear_color == bits))
+        return;
+
+    glClearColor(r, g, b, a);
+    m_clear_color = bits;
+    m_clear_color_known = true;
+}
+
+bool GlState::uniform_unchanged(int location, const uint32_t *bits, int n) noexcept
+{
+    // GL ignores location -1, so can we
+    if (location < 0)
+        return true;
+    if (!m_program_uniforms || location >= GL_STATE_MAX_UNIFORM_LOCATION)
+        return false;
+
+    if ((size_t)location >= m_program_uniforms->size())
+        m_program_uniforms->resize(location + 1, UniformValue{{}, false});
+    UniformValue &value = (*m_program_uniforms)[location];
+    bool unchanged = value.known;
+    for (int i = 0; i < n; i++)
+    {
+        unchanged = unchanged && value.bits[i] == bits[i];
+        value.bits[i] = bits[i];
+    }
+    value.known = true;
+    return unchanged;
+}
+
+void GlState::uniform1f(int location, float x) noexcept
+{
+    const uint32_t bits[] = {std::bit_cast<uint32_t>(x)};
+    if (skip(uniform_unchanged(location, bits, 1)))
+        return;
+
+    glUniform1f(location, x);
+}
+
+void GlState::uniform2f(int location, float x, float y) noexcept
+{
+    const uint32_t bits[] = {std::bit_cast<uint32_t>(x), std::bit_cast<uint32_t>(y)};
+    if (skip(uniform_unchanged(location, bits, 2)))
+        return;
+
+    glUniform2f(location, x, y);
+}
+
+void GlState::uniform3f(int location, float x, float y, float z) noexcept
+{
+    const uint32_t bits[] = {std::bit_cast<uint32_t>(x), std::bit_cast<uint32_t>(y), std::bit_cast<uint32_t>(z)};
+    if (skip(uniform_unchanged(location, bits, 3)))
+        return;
+
+    glUniform3f(location, x, y, z);
+}
+
+void GlState::uniform4f(int location, float x, float y, float z, float w) noexcept
+{
+    const uint32_t bits[] = {std::bit_cast<uint32_t>(x), std::bit_cast<uint32_t>(y), std::bit_cast<uint32_t>(z), std::bit_cast<uint32_t>(w)};
+    if (skip(uniform_unchanged(location, bits, 4)))
+        return;
+
+    glUniform4f(location, x, y, z, w);
+}
+
+void GlState::uniform1i(int location, int x) noexcept
+{
+    const uint32_t bits[] = {(uint32_t)x};
+    if (skip(uniform_unchanged(location, bits, 1)))
+        return;
+
+    glUniform1i(location, x);
+}
+
+void GlState::end_frame() noexcept
+{
+    m_last_frame = m_frame;
+    m_frame = GlStateStats{0, 0};
+}
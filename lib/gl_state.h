@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct GlStateStats
+{
+    unsigned long issued; // Calls that reached GL
+    unsigned long elided; // Calls skipped because the state was already set
+};
+
+// Shadow of the GL state App sets every frame. Setters compare against the shadow and only call into
+// GL on a change. Unknown state (after invalidate() or at startup) always goes through.
+// Code binding behind the cache's back must invalidate what it touched.
+class GlState
+{
+private:
+    static constexpr unsigned int UNKNOWN = UINT32_MAX;
+    static constexpr int N_BUFFER_TARGETS = 8;
+    static constexpr int N_TEXTURE_UNITS = 16;
+    static constexpr int N_TEXTURE_TARGETS = 4;
+    static constexpr int N_CAPABILITIES = 4;
+    static constexpr int N_UNIFORM_BINDINGS = 16;
+
+    struct BufferRange
+    {
+        unsigned int buffer;
+        size_t offset;
+        size_t size;
+    };
+
+    // Raw bits so -0.f vs 0.f and NaNs compare exactly like GL would store them
+    struct UniformValue
+    {
+        std::array<uint32_t, 4> bits;
+        bool known;
+    };
+
+    unsigned int m_program;
+    unsigned int m_vao;
+    std::array<unsigned int, N_BUFFER_TARGETS> m_buffers;
+    std::array<BufferRange, N_UNIFORM_BINDINGS> m_uniform_ranges;
+    unsigned int m_active_texture;
+    std::array<std::array<unsigned int, N_TEXTURE_TARGETS>, N_TEXTURE_UNITS> m_textures;
+    std::array<int, N_CAPABILITIES> m_capabilities; // -1 unknown
+    unsigned int m_blend_src;
+    unsigned int m_blend_dst;
+    unsigned int m_depth_func;
+    int m_depth_mask;
+    std::array<uint32_t, 4> m_clear_color;
+    bool m_clear_color_known;
+    // Uniform values are program state, kept per program and indexed by location
+    std::unordered_map<unsigned int, std::vector<UniformValue>> m_uniforms;
+    std::vector<UniformValue> *m_program_uniforms;
+    GlStateStats m_frame;
+    GlStateStats m_last_frame;
+
+    [[nodiscard]] bool skip(bool unchanged) noexcept
+    {
+        if (unchanged)
+            m_frame.elided++;
+        else
+            m_frame.issued++;
+        return unchanged;
+    }
+
+    // True when `location` already holds the value, records it otherwise
+    [[nodiscard]] bool uniform_unchanged(int location, const uint32_t *bits, int n) noexcept;
+
+public:
+    GlState();
+
+    // Everything unknown, e.g. after code that calls GL directly
+    void invalidate() noexcept;
+    void invalidate_buffer(unsigned int target) noexcept;
+
+    // Call before deleting objects, GL unbinds them and may reuse their names
+    void forget_program(unsigned int program) noexcept;
+    void forget_vertex_array(unsigned int vao) noexcept;
+    void forget_buffer(unsigned int buffer) noexcept;
+    void forget_texture(unsigned int texture) noexcept;
+
+    void use_program(unsigned int program) noexcept;
+    // Also forgets the element buffer binding, which belongs to the VAO
+    void bind_vertex_array(unsigned int vao) noexcept;
+    void bind_buffer(unsigned int target, unsigned int buffer) noexcept;
+    // Indexed GL_UNIFORM_BUFFER ranges are shadowed, other targets pass through
+    void bind_buffer_range(unsigned int target, unsigned int index, unsigned int buffer, size_t offset, size_t size) noexcept;
+    void bind_texture(unsigned int unit, unsigned int target, unsigned int texture) noexcept;
+    void set_capability(unsigned int capability, bool enabled) noexcept; // GL_BLEND, GL_DEPTH_TEST, GL_CULL_FACE, GL_SCISSOR_TEST
+    void blend_func(unsigned int src, unsigned int dst) noexcept;
+    void depth_func(unsigned int func) noexcept;
+    void depth_mask(bool write) noexcept;
+    void clear_color(float r, float g, float b, float a) noexcept;
+
+    // Uniforms of the program in use
+    void uniform1f(int location, float x) noexcept;
+    void uniform2f(int location, float x, float y) noexcept;
+    void uniform3f(int location, float x, float y, float z) noexcept;
+    void uniform4f(int location, float x, float y, float z, float w) noexcept;
+    void uniform1i(int location, int x) noexcept;
+
+    // Rolls the per-frame counters
+    void end_frame() noexcept;
+
+    [[nodiscard]] constexpr unsigned int program() const noexcept
+    {
+        return m_program;
+    }
+
+    [[nodiscard]] constexpr const GlStateStats &last_frame() const noexcept
+    {
+        return m_last_frame;
+    }
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+constexpr uint64_t HASH64_SEED = 14695981039346656037ull;
+
+// 64 bit FNV-1a, chain calls by passing the previous hash as seed
+[[nodiscard]] constexpr uint64_t hash64(std::string_view data, uint64_t seed = HASH64_SEED) noexcept
+{
+    uint64_t hash = seed;
+    for (char c : data)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Feeds the 8 bytes of `value` into the hash, e.g. to combine precomputed hashes at compile time
+[[nodiscard]] constexpr uint64_t hash64_combine(uint64_t value, uint64_t seed = HASH64_SEED) noexcept
+{
+    uint64_t hash = seed;
+    for (int i = 0; i < 8; i++)
+    {
+        hash ^= (value >> (i * 8)) & 0xFF;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "job_system.h"
+#include "trace.h"
+
+// JobCounter::m_state halves, the list head is a job handle or one of these
+constexpr uint32_t NO_DEPENDENT = 0xffffffff;
+constexpr uint32_t COUNTER_DONE = 0xfffffffe;
+constexpr int JOB_SPINS = 64; // Failed searches before a worker sleeps
+
+static inline uint64_t pack_state(uint32_t pending, uint32_t head) noexcept
+{
+    return (uint64_t)head << 32 | pending;
+}
+
+JobCounter::JobCounter() noexcept
+    : m_state(pack_state(0, COUNTER_DONE))
+{
+}
+
+bool JobCounter::done() const noexcept
+{
+    return (uint32_t)m_state.load(std::memory_order_acquire) == 0;
+}
+
+JobSystem::JobSystem(unsigned int n_workers)
+    : m_epoch(0), m_sleepers(0), m_stop(false), m_frame_start(Clock::now())
+{
+    if (n_workers == 0)
+        n_workers = std::max(1u, std::thread::hardware_concurrency());
+    if (n_workers > 0xffff)
+        throw std::runtime_error(std::format("Too many job workers: {}", n_workers));
+
+    for (unsigned int i = 0; i < n_workers; i++)
+    {
+        auto worker = std::make_unique<Worker>();
+        worker->pool = std::make_unique<Job[]>(JOB_POOL_SIZE);
+        worker->next_slot = 0;
+        m_workers.push_back(std::move(worker));
+    }
+    m_workers[0]->thread = std::this_thread::get_id();
+    // Ids are known before any job can be queued, worker_index() reads them unsynchronized
+    for (unsigned int i = 1; i < n_workers; i++)
+    {
+        m_threads.emplace_back(&JobSystem::worker_loop, this, i);
+        m_workers[i]->thread = m_threads.back().get_id();
+    }
+
+    m_frame_base.resize(n_workers);
+    m_last_frame.resize(n_workers);
+}
+
+JobSystem::~JobSystem()
+{
+    m_stop.store(true, std::memory_order_seq_cst);
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    m_epoch.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+void JobSystem::worker_loop(unsigned int index) noexcept
+{
+    TRACE_THREAD_NAME("job worker");
+    int spins = 0;
+    uint32_t handle;
+    while (!m_stop.load(std::memory_order_acquire))
+    {
+        if (find(index, handle))
+        {
+            execute(index, handle);
+            spins = 0;
+            continue;
+        }
+        if (++spins < JOB_SPINS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // Register before the last look, a push after it bumps the epoch and wakes us
+        m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+        uint32_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        bool found = find(index, handle);
+        if (!found && !m_stop.load(std::memory_order_seq_cst))
+            m_epoch.wait(epoch, std::memory_order_seq_cst);
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if (found)
+            execute(index, handle);
+        spins = 0;
+    }
+}
+
+unsigned int JobSystem::worker_index() const
+{
+    std::thread::id self = std::this_thread::get_id();
+    for (unsigned int i = 0; i < m_workers.size(); i++)
+        if (m_workers[i]->thread == self)
+            return i;
+    throw std::runtime_error("Jobs can only be queued and waited on by threads of their JobSystem");
+}
+
+Job &JobSystem::job(uint32_t handle) noexcept
+{
+    return m_workers[handle >> 16]->pool[handle & 0xffff];
+}
+
+bool JobSystem::try_allocate(unsigned int worker, uint32_t &handle) noexcept
+{
+    Worker &owner = *m_workers[worker];
+    uint32_t slot = owner.next_slot % JOB_POOL_SIZE;
+    Job &job = owner.pool[slot];
+    if (job.in_use.load(std::memory_order_acquire))
+        return false;
+    owner.next_slot++;
+    job.in_use.store(true, std::memory_order_relaxed);
+    handle = worker << 16 | slot;
+    return true;
+}
+
+uint32_t JobSystem::allocate(unsigned int worker)
+{
+    uint32_t handle;
+    if (!try_allocate(worker, handle))
+        throw std::runtime_error(std::format("Job pool of worker {} exhausted, {} jobs in flight", worker, JOB_POOL_SIZE));
+    return handle;
+}
+
+void JobSystem::push(unsigned int worker, uint32_t handle) noexcept
+{
+    // Pool and deque have the same size, a full deque means every slot is taken
+    if (!m_workers[worker]->deque.push(handle))
+        execute(worker, handle);
+}
+
+void JobSystem::wake() noexcept
+{
+    m_epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (m_sleepers.load(std::memory_order_seq_cst) != 0)
+        m_epoch.notify_all();
+}
+
+bool JobSystem::find(unsigned int worker, uint32_t &handle) noexcept
+{
+    Worker &self = *m_workers[worker];
+    if (self.deque.pop(handle))
+        return true;
+
+    unsigned int n = m_workers.size();
+    for (unsigned int i = 1; i < n; i++)
+    {
+        if (m_workers[(worker + i) % n]->deque.steal(handle))
+        {
+            self.steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::run_job(unsigned int worker, const Job &job) noexcept
+{
+    Clock::time_point start = Clock::now();
+    job.function(job, worker);
+    uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+    Worker &self = *m_workers[worker];
+    self.busy_ns.fetch_add(ns, std::memory_order_relaxed);
+    self.jobs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void JobSystem::execute(unsigned int worker, uint32_t handle) noexcept
+{
+    Job &job = this->job(handle);
+    run_job(worker, job);
+
+    // The slot may be reused as soon as it is released
+    JobCounter &counter = *job.counter;
+    job.in_use.store(false, std::memory_order_release);
+    finish(worker, counter);
+}
+
+void JobSystem::add(JobCounter &counter, uint32_t n) noexcept
+{
+    uint64_t state = counter.m_state.load(std::memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        uint32_t head = state >> 32;
+        next = pack_state((uint32_t)state + n, head == COUNTER_DONE ? NO_DEPENDENT : head);
+    } while (!counter.m_state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+}
+
+void JobSystem::finish(unsigned int worker, JobCounter &counter) noexcept
+{
+    uint64_t state = counter.m_state.load(std::memory_order_relaxed);
+    uint64_t next;
+    do
+    {
+        uint32_t pending = state;
+        next = pending == 1 ? pack_state(0, COUNTER_DONE) : pack_state(pending - 1, state >> 32);
+    } while (!counter.m_state.compare_exchange_weak(state, next, std::memory_order_acq_rel, std::memory_order_acquire));
+    if ((uint32_t)state != 1)
+        return;
+
+    // Last job, the counter may be gone already: only the detached list is left to walk
+    for (uint32_t handle = state >> 32; handle != NO_DEPENDENT;)
+    {
+        uint32_t next_handle = job(handle).next;
+        push(worker, handle);
+        handle = next_handle;
+    }
+    wake();
+}
+
+void JobSystem::submit(void (*function)(const Job &, unsigned int), const void *data, JobCounter &counter, JobCounter *dependency)
+{
+    unsigned int worker = worker_index();
+    uint32_t handle = allocate(worker);
+    Job &job = this->job(handle);
+    job.function = function;
+    job.data = data;
+    job.begin = 0;
+    job.end = 0;
+    job.counter = &counter;
+    job.next = NO_DEPENDENT;
+    add(counter, 1);
+
+    if (dependency)
+    {
+        // Join the dependency's list unless it finished, the release CAS publishes the job
+        uint64_t state = dependency->m_state.load(std::memory_order_acquire);
+        while ((uint32_t)state != 0)
+        {
+            job.next = state >> 32;
+            if (dependency->m_state.compare_exchange_weak(state, pack_state((uint32_t)state, handle), std::memory_order_acq_rel, std::memory_order_acquire))
+                return;
+        }
+    }
+    push(worker, handle);
+    wake();
+}
+
+void JobSystem::submit_range(void (*function)(const Job &, unsigned int), const void *data, size_t n, size_t grain, JobCounter &counter)
+{
+    grain = std::max<size_t>(grain, 1);
+    size_t n_jobs = (n + grain - 1) / grain;
+    if (n_jobs == 0)
+        return;
+
+    // Everything is counted first so the counter cannot finish while the rest is queued
+    unsigned int worker = worker_index();
+    add(counter, n_jobs);
+    for (size_t i = 0; i < n_jobs; i++)
+    {
+        size_t begin = i * grain, end = std::min(n, begin + grain);
+        uint32_t handle;
+        if (!try_allocate(worker, handle))
+        {
+            // Pool exhausted, the chunk runs here like a push to a full deque does
+            Job chunk{function, data, begin, end, &counter, NO_DEPENDENT, {}};
+            run_job(worker, chunk);
+            finish(worker, counter);
+            continue;
+        }
+        Job &job = this->job(handle);
+        job.function = function;
+        job.data = data;
+        job.begin = begin;
+        job.end = end;
+        job.counter = &counter;
+        job.next = NO_DEPENDENT;
+        push(worker, handle);
+    }
+    wake();
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+    unsigned int worker = worker_index();
+    uint32_t handle;
+    while (!counter.done())
+    {
+        if (find(worker, handle))
+        {
+            execute(worker, handle);
+            continue;
+        }
+
+        m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+        uint32_t epoch = m_epoch.load(std::memory_order_seq_cst);
+        bool found = find(worker, handle);
+        if (!found && !counter.done())
+            m_epoch.wait(epoch, std::memory_order_seq_cst);
+        m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+        if (found)
+            execute(worker, handle);
+    }
+}
+
+void JobSystem::end_frame() noexcept
+{
+    Clock::time_point now = Clock::now();
+    double frame_ms = std::chrono::duration<double, std::milli>(now - m_frame_start).count();
+    m_frame_start = now;
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        const Worker &worker = *m_workers[i];
+        JobWorkerStats total = {
+            worker.jobs.load(std::memory_order_relaxed),
+            worker.steals.load(std::memory_order_relaxed),
+            worker.busy_ns.load(std::memory_order_relaxed) / 1e6,
+            0,
+        };
+        JobWorkerStats &base = m_frame_base[i];
+        JobWorkerStats &frame = m_last_frame[i];
+        frame.jobs = total.jobs - base.jobs;
+        frame.steals = total.steals - base.steals;
+        frame.busy_ms = total.busy_ms - base.busy_ms;
+        frame.utilization = frame_ms > 0 ? std::min(1.0, frame.busy_ms / frame_ms) : 0;
+        base = total;
+    }
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "constant.h"
+#include "work_stealing_deque.h"
+
+// Jobs of a group still to run. Jobs made to depend on it are queued once it drops to zero.
+class JobCounter
+{
+private:
+    friend class JobSystem;
+
+    // Pending jobs in the low half, the first dependent job in the high half, one CAS updates both
+    std::atomic<uint64_t> m_state;
+
+public:
+    JobCounter() noexcept;
+    JobCounter(const JobCounter &) = delete;
+    JobCounter &operator=(const JobCounter &) = delete;
+
+    // Nothing pending and the dependents queued, the counter may be destroyed or reused
+    [[nodiscard]] bool done() const noexcept;
+};
+
+struct Job
+{
+    void (*function)(const Job &job, unsigned int worker);
+    const void *data; // The callable
+    size_t begin;     // parallel_for range
+    size_t end;
+    JobCounter *counter;
+    uint32_t next;            // Next dependent of the same counter
+    std::atomic<bool> in_use; // The pool slot is taken until the job ran
+};
+
+// One worker over the last frame, between two end_frame() calls
+struct JobWorkerStats
+{
+    unsigned long jobs;
+    unsigned long steals;
+    double busy_ms;
+    double utilization; // Share of the frame's wall time spent in jobs
+};
+
+// Work-stealing job system. Every worker owns a deque, pops its own newest job and steals the
+// oldest of the others once it runs dry. The thread creating it is worker 0: it queues and waits
+// on jobs and runs them while waiting, the other threads sleep when there is nothing to steal.
+// Jobs come from a per-thread pool of JOB_POOL_SIZE, a thread may have that many in flight: run
+// throws past it, parallel_for runs the extra chunks on the calling thread.
+class JobSystem
+{
+    static_assert(JOB_POOL_SIZE <= 0x10000, "Job handles keep the pool slot in 16 bits");
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Worker
+    {
+        WorkStealingDeque<uint32_t, JOB_POOL_SIZE> deque; // Job handles, worker << 16 | pool slot
+        std::unique_ptr<Job[]> pool;
+        uint32_t next_slot;
+        std::thread::id thread;
+        // Written by the worker only
+        std::atomic<unsigned long> jobs;
+        std::atomic<unsigned long> steals;
+        std::atomic<uint64_t> busy_ns;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+    std::atomic<uint32_t> m_epoch; // Bumped when work shows up or a counter finishes
+    std::atomic<unsigned int> m_sleepers;
+    std::atomic<bool> m_stop;
+    Clock::time_point m_frame_start;
+    std::vector<JobWorkerStats> m_frame_base; // Totals at the frame start
+    std::vector<JobWorkerStats> m_last_frame;
+
+    void worker_loop(unsigned int index) noexcept;
+    [[nodiscard]] unsigned int worker_index() const;
+    [[nodiscard]] Job &job(uint32_t handle) noexcept;
+    [[nodiscard]] bool try_allocate(unsigned int worker, uint32_t &handle) noexcept;
+    [[nodiscard]] uint32_t allocate(unsigned int worker);
+    void push(unsigned int worker, uint32_t handle) noexcept;
+    void wake() noexcept;
+    [[nodiscard]] bool find(unsigned int worker, uint32_t &handle) noexcept;
+    void run_job(unsigned int worker, const Job &job) noexcept;
+    void execute(unsigned int worker, uint32_t handle) noexcept;
+    void add(JobCounter &counter, uint32_t n) noexcept;
+    void finish(unsigned int worker, JobCounter &counter) noexcept;
+    void submit(void (*function)(const Job &, unsigned int), const void *data, JobCounter &counter, JobCounter *dependency);
+    void submit_range(void (*function)(const Job &, unsigned int), const void *data, size_t n, size_t grain, JobCounter &counter);
+
+    template <typename F>
+    static void call(const Job &job, unsigned int worker)
+    {
+        (*(const F *)job.data)(worker);
+    }
+
+    template <typename F>
+    static void call_range(const Job &job, unsigned int worker)
+    {
+        (*(const F *)job.data)(job.begin, job.end, worker);
+    }
+
+public:
+    // 0 workers is one per hardware thread, the calling thread included
+    explicit JobSystem(unsigned int n_workers = 0);
+    JobSystem(const JobSystem &) = delete;
+    JobSystem &operator=(const JobSystem &) = delete;
+    ~JobSystem();
+
+    // Queue f(worker), counted by `counter`, to run once `dependency` is done when given. `f` must
+    // outlive the job, e.g. the caller waits on `counter`. Workers may queue jobs of their own.
+    template <typename F>
+    void run(const F &f, JobCounter &counter, JobCounter *dependency = nullptr)
+    {
+        submit(&call<F>, &f, counter, dependency);
+    }
+    template <typename F>
+    void run(const F &&f, JobCounter &counter, JobCounter *dependency = nullptr) = delete;
+
+    // f(begin, end, worker) over [0, n) in chunks of `grain`, returns once all of them ran. The
+    // chunks are fixed by n and grain only, not by which worker runs them.
+    template <typename F>
+    void parallel_for(size_t n, size_t grain, const F &f)
+    {
+        JobCounter counter;
+        submit_range(&call_range<F>, &f, n, grain, counter);
+        wait(counter);
+    }
+
+    // Run jobs until `counter` is done
+    void wait(JobCounter &counter);
+
+    [[nodiscard]] unsigned int size() const noexcept
+    {
+        return m_workers.size();
+    }
+
+    // Close the frame's stats, from worker 0
+    void end_frame() noexcept;
+
+    [[nodiscard]] std::span<const JobWorkerStats> last_frame() const noexcept
+    {
+        return m_last_frame;
+    }
+};
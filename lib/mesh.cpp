@@ -0,0 +1,266 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <span>
+#include <stdexcept>
+
+#include "mesh.h"
+
+MeshRegistry::MeshRegistry(const std::span<const VertexAttribDesc> attribs, size_t vertex_capacity, size_t index_capacity, bool gl)
+    : m_gl(gl),
+      m_attribs(attribs.begin(), attribs.end()),
+      m_stride(attribs.empty() ? 0 : attribs[0].stride),
+      m_va_id(0),
+      m_vb_id(0),
+      m_eb_id(0),
+      m_vertices(vertex_capacity),
+      m_indices(index_capacity),
+      m_n_meshes(0),
+      m_grows(0)
+{
+    if (m_stride <= 0 || std::any_of(m_attribs.begin(), m_attribs.end(), [&](const VertexAttribDesc &attrib)
+                                     { return attrib.stream != 0 || attrib.stride != m_stride; }))
+        throw std::runtime_error("Mesh registry needs an interleaved vertex layout");
+
+    if (!m_gl)
+    {
+        m_cpu_vertices.resize(vertex_capacity * m_stride);
+        m_cpu_elements.resize(index_capacity);
+        return;
+    }
+
+    // Storage through the copy target, the VAO only sees the buffers in bind_attribs
+    glGenBuffers(1, &m_vb_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vb_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity * m_stride, NULL, GL_STATIC_DRAW);
+    glGenBuffers(1, &m_eb_id);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_eb_id);
+    glBufferData(GL_COPY_WRITE_BUFFER, index_capacity * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+
+    glGenVertexArrays(1, &m_va_id);
+    bind_attribs();
+}
+
+MeshRegistry::~MeshRegistry()
+{
+    if (!m_gl)
+        return;
+
+    glDeleteVertexArrays(1, &m_va_id);
+    glDeleteBuffers(1, &m_vb_id);
+    glDeleteBuffers(1, &m_eb_id);
+}
+
+void MeshRegistry::bind_attribs() noexcept
+{
+    // Leaves the registry VAO bound
+    glBindVertexArray(m_va_id);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vb_id);
+    for (const VertexAttribDesc &attrib : m_attribs)
+    {
+        glVertexAttribPointer(attrib.location, attrib.components, attrib.gl_type, attrib.normalized, attrib.stride, (void *)attrib.offset);
+        glEnableVertexAttribArray(attrib.location);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_eb_id);
+}
+
+// Copy a buffer into a larger one on the GPU, returns the new buffer
+static unsigned int grow_buffer(unsigned int buffer, size_t old_size, size_t new_size) noexcept
+{
+    unsigned int grown;
+    glGenBuffers(1, &grown);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+    glBufferData(GL_COPY_WRITE_BUFFER, new_size, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, old_size);
+    glDeleteBuffers(1, &buffer);
+    return grown;
+}
+
+void MeshRegistry::grow_vertices(size_t min_capacity)
+{
+    size_t old_capacity = m_vertices.capacity();
+    size_t capacity = std::max(old_capacity * 2, old_capacity + min_capacity);
+    if (m_gl)
+    {
+        m_vb_id = grow_buffer(m_vb_id, old_capacity * m_stride, capacity * m_stride);
+        bind_attribs();
+    }
+    else
+    {
+        m_cpu_vertices.resize(capacity * m_stride);
+    }
+    m_vertices.grow(capacity);
+    m_grows++;
+}
+
+void MeshRegistry::grow_indices(size_t min_capacity)
+{
+    size_t old_capacity = m_indices.capacity();
+    size_t capacity = std::max(old_capacity * 2, old_capacity + min_capacity);
+    if (m_gl)
+    {
+        m_eb_id = grow_buffer(m_eb_id, old_capacity * sizeof(unsigned int), capacity * sizeof(unsigned int));
+        bind_attribs();
+    }
+    else
+    {
+        m_cpu_elements.resize(capacity);
+    }
+    m_indices.grow(capacity);
+    m_grows++;
+}
+
+MeshHandle MeshRegistry::create(const std::span<const std::byte> vertices, const std::span<const unsigned int> elements)
+{
+    MeshHandle mesh = reserve(vertices, elements);
+    write_vertices(mesh, 0, vertices);
+    write_elements(mesh, 0, elements);
+    m_slots[mesh.index].complete = true;
+    return mesh;
+}
+
+MeshHandle MeshRegistry::reserve(const std::span<const std::byte> vertices, const std::span<const unsigned int> elements)
+{
+    size_t n_vertices = vertices.size() / m_stride;
+    if (n_vertices == 0 || vertices.size() % m_stride != 0)
+        throw std::runtime_error(std::format("Mesh vertices are {} bytes, not whole vertices of {} bytes", vertices.size(), m_stride));
+    if (elements.empty())
+        throw std::runtime_error("Mesh has no elements");
+
+    // Base vertex draws cannot catch an index reaching into the next mesh
+    unsigned int max_element = *std::max_element(elements.begin(), elements.end());
+    if (max_element >= n_vertices)
+        throw std::runtime_error(std::format("Mesh element {} out of range, {} vertices", max_element, n_vertices));
+
+    // Free space first, the arenas only grow when the allocator has no fitting block
+    uint32_t vertex_block = m_vertices.allocate(n_vertices);
+    if (vertex_block == TlsfAllocator::NONE)
+    {
+        grow_vertices(n_vertices);
+        vertex_block = m_vertices.allocate(n_vertices);
+    }
+    uint32_t index_block = m_indices.allocate(elements.size());
+    if (index_block == TlsfAllocator::NONE)
+    {
+        grow_indices(elements.size());
+        index_block = m_indices.allocate(elements.size());
+    }
+
+    uint32_t index;
+    if (!m_free_slots.empty())
+    {
+        index = m_free_slots.back();
+        m_free_slots.pop_back();
+    }
+    else
+    {
+        index = m_slots.size();
+        m_slots.push_back(Slot{});
+    }
+    Slot &slot = m_slots[index];
+    slot.range = MeshRange{(int)m_vertices.offset(vertex_block), m_indices.offset(index_block), (int)elements.size(), n_vertices};
+    slot.vertex_block = vertex_block;
+    slot.index_block = index_block;
+    slot.live = true;
+    slot.complete = false;
+    m_n_meshes++;
+    return MeshHandle{index, slot.generation};
+}
+
+void MeshRegistry::write_vertices(MeshHandle mesh, size_t offset, const std::span<const std::byte> vertices)
+{
+    const MeshRange &range = slot(mesh).range;
+    if (offset > range.n_vertices * m_stride || vertices.size() > range.n_vertices * m_stride - offset)
+        throw std::runtime_error(std::format("Mesh vertex bytes [{}, {}) out of range, {} in the mesh", offset, offset + vertices.size(), range.n_vertices * m_stride));
+
+    offset += (size_t)range.base_vertex * m_stride;
+    if (!m_gl)
+    {
+        memcpy(m_cpu_vertices.data() + offset, vertices.data(), vertices.size());
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_vb_id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, vertices.size(), vertices.data());
+}
+
+void MeshRegistry::write_elements(MeshHandle mesh, size_t first, const std::span<const unsigned int> elements)
+{
+    const MeshRange &range = slot(mesh).range;
+    if (first > (size_t)range.count || elements.size() > range.count - first)
+        throw std::runtime_error(std::format("Mesh elements [{}, {}) out of range, {} in the mesh", first, first + elements.size(), range.count));
+
+    first += range.first_index;
+    if (!m_gl)
+    {
+        memcpy(m_cpu_elements.data() + first, elements.data(), elements.size_bytes());
+        return;
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_eb_id);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, first * sizeof(unsigned int), elements.size_bytes(), elements.data());
+}
+
+const MeshRegistry::Slot &MeshRegistry::slot(MeshHandle mesh) const
+{
+    if (mesh.index >= m_slots.size() || !m_slots[mesh.index].live || m_slots[mesh.index].generation != mesh.generation)
+        throw std::runtime_error(std::format("Invalid mesh handle {}:{}", mesh.index, mesh.generation));
+
+    return m_slots[mesh.index];
+}
+
+void MeshRegistry::destroy(MeshHandle mesh)
+{
+    // Draws already submitted keep reading the old contents, GL orders the later uploads after them
+    const Slot &live = slot(mesh);
+    m_vertices.free(live.vertex_block);
+    m_indices.free(live.index_block);
+
+    Slot &dead = m_slots[mesh.index];
+    dead.live = false;
+    dead.generation++;
+    m_free_slots.push_back(mesh.index);
+    m_n_meshes--;
+}
+
+MeshRange MeshRegistry::range(MeshHandle mesh) const
+{
+    const Slot &live = slot(mesh);
+    if (!live.complete)
+        return MeshRange{live.range.base_vertex, live.range.first_index, 0, 0};
+
+    return live.range;
+}
+
+void MeshRegistry::set_complete(MeshHandle mesh)
+{
+    (void)slot(mesh);
+    m_slots[mesh.index].complete = true;
+}
+
+bool MeshRegistry::complete(MeshHandle mesh) const
+{
+    return slot(mesh).complete;
+}
+
+std::span<const std::byte> MeshRegistry::cpu_vertices(const MeshRange &range) const noexcept
+{
+    if (m_gl)
+        return {};
+
+    return std::span<const std::byte>(m_cpu_vertices).subspan((size_t)range.base_vertex * m_stride, range.n_vertices * m_stride);
+}
+
+std::span<const unsigned int> MeshRegistry::cpu_elements(const MeshRange &range) const noexcept
+{
+    if (m_gl)
+        return {};
+
+    return std::span<const unsigned int>(m_cpu_elements).subspan(range.first_index, range.count);
+}
+
+MeshRegistryStats MeshRegistry::stats() const noexcept
+{
+    return MeshRegistryStats{m_n_meshes, m_vertices.used(), m_vertices.capacity(), m_indices.used(), m_indices.capacity(), m_grows};
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "tlsf.h"
+#include "vertex_layout.h"
+
+// Stale handles are caught by the generation, a destroyed slot gets a new one when reused
+struct MeshHandle
+{
+    uint32_t index;
+    uint32_t generation;
+
+    [[nodiscard]] constexpr bool valid() const noexcept
+    {
+        return index != UINT32_MAX;
+    }
+
+    [[nodiscard]] constexpr bool operator==(const MeshHandle &) const noexcept = default;
+};
+
+constexpr MeshHandle INVALID_MESH = {UINT32_MAX, 0};
+
+// Where a mesh lives in the shared buffers, arguments of glDrawElementsBaseVertex
+struct MeshRange
+{
+    int base_vertex;
+    size_t first_index;
+    int count;
+    size_t n_vertices;
+};
+
+struct MeshRegistryStats
+{
+    size_t meshes;
+    size_t vertices_used; // In vertices
+    size_t vertex_capacity;
+    size_t indices_used;
+    size_t index_capacity;
+    unsigned long grows; // Buffer reallocations
+};
+
+// Many meshes of one vertex format suballocated out of a shared vertex buffer and a shared index
+// buffer, read by one VAO. Meshes are drawn by base vertex and index offset, so switching meshes
+// needs no VAO or buffer binds. Without GL (`gl` false) the arenas are plain CPU memory.
+class MeshRegistry
+{
+private:
+    struct Slot
+    {
+        MeshRange range;
+        uint32_t vertex_block;
+        uint32_t index_block;
+        uint32_t generation;
+        bool live;
+        bool complete; // Drawn, reserved meshes are not until set_complete
+    };
+
+    bool m_gl;
+    std::vector<VertexAttribDesc> m_attribs;
+    int m_stride;
+    unsigned int m_va_id;
+    unsigned int m_vb_id;
+    unsigned int m_eb_id;
+    std::vector<std::byte> m_cpu_vertices;
+    std::vector<unsigned int> m_cpu_elements;
+    TlsfAllocator m_vertices;
+    TlsfAllocator m_indices;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_free_slots;
+    size_t m_n_meshes;
+    unsigned long m_grows;
+
+    [[nodiscard]] const Slot &slot(MeshHandle mesh) const;
+    // Reallocate one arena with room for at least `min_capacity` more units, contents are kept
+    void grow_vertices(size_t min_capacity);
+    void grow_indices(size_t min_capacity);
+    void bind_attribs() noexcept;
+
+public:
+    // Interleaved single stream format, the GL version needs a current context
+    MeshRegistry(const std::span<const VertexAttribDesc> attribs, size_t vertex_capacity, size_t index_capacity, bool gl = true);
+    MeshRegistry(const MeshRegistry &) = delete;
+    MeshRegistry &operator=(const MeshRegistry &) = delete;
+    ~MeshRegistry();
+
+    // `vertices` holds whole vertices of the registry's stride, elements index into them
+    [[nodiscard]] MeshHandle create(const std::span<const std::byte> vertices, const std::span<const unsigned int> elements);
+    // Checked and given room like create, but nothing written: the contents are undefined until
+    // the write calls covered them, in any number of pieces, and the mesh has an empty range until
+    // set_complete
+    [[nodiscard]] MeshHandle reserve(const std::span<const std::byte> vertices, const std::span<const unsigned int> elements);
+    // `offset` in bytes into the mesh's vertices, `first` in elements
+    void write_vertices(MeshHandle mesh, size_t offset, const std::span<const std::byte> vertices);
+    void write_elements(MeshHandle mesh, size_t first, const std::span<const unsigned int> elements);
+    void set_complete(MeshHandle mesh);
+    [[nodiscard]] bool complete(MeshHandle mesh) const;
+    void destroy(MeshHandle mesh);
+
+    // Zero count while the mesh is not complete, so draws of it draw nothing
+    [[nodiscard]] MeshRange range(MeshHandle mesh) const;
+
+    // CPU arenas, only filled without GL
+    [[nodiscard]] std::span<const std::byte> cpu_vertices(const MeshRange &range) const noexcept;
+    [[nodiscard]] std::span<const unsigned int> cpu_elements(const MeshRange &range) const noexcept;
+
+    [[nodiscard]] constexpr unsigned int vao() const noexcept
+    {
+        return m_va_id;
+    }
+
+    [[nodiscard]] constexpr int stride() const noexcept
+    {
+        return m_stride;
+    }
+
+    [[nodiscard]] MeshRegistryStats stats() const noexcept;
+};
@@ -0,0 +1,192 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "profiler.h"
+#include "constant.h"
+
+const char *frame_phase_name(FramePhase phase) noexcept
+{
+    switch (phase)
+    {
+    case FramePhase::Input:
+        return "input";
+    case FramePhase::Clear:
+        return "clear";
+    case FramePhase::Uniforms:
+        return "uniforms";
+    case FramePhase::Draw:
+        return "draw";
+    case FramePhase::Swap:
+        return "swap";
+    case FramePhase::Poll:
+        return "poll";
+    default:
+        return "unknown";
+    }
+}
+
+FrameProfiler::FrameProfiler(bool gpu_timing)
+    : m_gpu(gpu_timing),
+      m_query_head(0),
+      m_records(PROFILER_HISTORY),
+      m_frame(0),
+      m_in_frame(false),
+      m_phase(-1)
+{
+    if (!m_gpu)
+        return;
+
+    m_queries.resize(PROFILER_QUERY_RING);
+    m_query_frame.assign(PROFILER_QUERY_RING, -1);
+    glGenQueries(m_queries.size(), m_queries.data());
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    if (m_gpu)
+        glDeleteQueries(m_queries.size(), m_queries.data());
+}
+
+void FrameProfiler::collect_queries() noexcept
+{
+    // Queries complete in submission order, stop at the first pending one
+    for (size_t i = 0; i < m_queries.size(); i++)
+    {
+        size_t slot = (m_query_head + i) % m_queries.size();
+        long frame = m_query_frame[slot];
+        if (frame < 0)
+            continue;
+
+        GLint available = 0;
+        glGetQueryObjectiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 elapsed_ns = 0;
+        glGetQueryObjectui64v(m_queries[slot], GL_QUERY_RESULT, &elapsed_ns);
+        FrameRecord &record = m_records[frame % m_records.size()];
+        if (record.frame == (unsigned long)frame)
+            record.gpu_ms = elapsed_ns / 1e6;
+        m_query_frame[slot] = -1;
+    }
+}
+
+void FrameProfiler::begin_frame() noexcept
+{
+    FrameRecord &record = m_records[m_frame % m_records.size()];
+    record.frame = m_frame;
+    record.cpu_ms.fill(0.);
+    record.cpu_total_ms = 0.;
+    record.gpu_ms = -1.;
+
+    // The first frame pays for lazy driver setup (llvmpipe even reports a bogus elapsed time for it),
+    // it is not timed on the GPU
+    if (m_gpu && m_frame > 0)
+    {
+        // Every query in flight means the GPU is that many frames behind, skip GPU timing this frame
+        collect_queries();
+        if (m_query_frame[m_query_head] < 0)
+        {
+            glBeginQuery(GL_TIME_ELAPSED, m_queries[m_query_head]);
+            m_query_frame[m_query_head] = m_frame;
+        }
+    }
+
+    m_in_frame = true;
+    m_phase = -1;
+    m_frame_start = Clock::now();
+    m_phase_start = m_frame_start;
+}
+
+void FrameProfiler::phase(FramePhase phase) noexcept
+{
+    if (!m_in_frame)
+        return;
+
+    auto now = Clock::now();
+    if (m_phase >= 0)
+        m_records[m_frame % m_records.size()].cpu_ms[m_phase] += std::chrono::duration<double, std::milli>(now - m_phase_start).count();
+    m_phase = (int)phase;
+    m_phase_start = now;
+}
+
+void FrameProfiler::end_frame() noexcept
+{
+    if (!m_in_frame)
+        return;
+
+    auto now = Clock::now();
+    FrameRecord &record = m_records[m_frame % m_records.size()];
+    if (m_phase >= 0)
+        record.cpu_ms[m_phase] += std::chrono::duration<double, std::milli>(now - m_phase_start).count();
+    record.cpu_total_ms = std::chrono::duration<double, std::milli>(now - m_frame_start).count();
+
+    if (m_gpu && m_query_frame[m_query_head] == (long)m_frame)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        m_query_head = (m_query_head + 1) % m_queries.size();
+    }
+
+    m_in_frame = false;
+    m_frame++;
+}
+
+std::vector<FrameRecord> FrameProfiler::records() const
+{
+    size_t n = std::min<size_t>(m_frame, m_records.size());
+    std::vector<FrameRecord> out;
+    out.reserve(n);
+    for (unsigned long frame = m_frame - n; frame < m_frame; frame++)
+        out.push_back(m_records[frame % m_records.size()]);
+    return out;
+}
+
+// Nearest rank percentiles
+static PercentileSummary percentiles(std::vector<double> &values) noexcept
+{
+    if (values.empty())
+        return PercentileSummary{0., 0., 0.};
+
+    std::sort(values.begin(), values.end());
+    auto rank = [&](double p)
+    {
+        size_t i = (size_t)std::ceil(p * values.size());
+        return values[std::clamp<size_t>(i, 1, values.size()) - 1];
+    };
+    return PercentileSummary{rank(0.50), rank(0.95), rank(0.99)};
+}
+
+ProfileSummary FrameProfiler::summary() const
+{
+    std::vector<FrameRecord> frames = records();
+    ProfileSummary summary;
+    summary.n_frames = frames.size();
+
+    std::vector<double> values;
+    values.reserve(frames.size());
+    for (int phase = 0; phase < N_FRAME_PHASE; phase++)
+    {
+        values.clear();
+        for (const auto &frame : frames)
+            values.push_back(frame.cpu_ms[phase]);
+        summary.cpu_ms[phase] = percentiles(values);
+    }
+
+    values.clear();
+    for (const auto &frame : frames)
+        values.push_back(frame.cpu_total_ms);
+    summary.cpu_total_ms = percentiles(values);
+
+    values.clear();
+    for (const auto &frame : frames)
+        if (frame.gpu_ms >= 0.)
+            values.push_back(frame.gpu_ms);
+    summary.n_gpu_frames = values.size();
+    summary.gpu_ms = percentiles(values);
+
+    return summary;
+}
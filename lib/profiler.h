@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <vector>
+
+enum class FramePhase
+{
+    Input,
+    Clear,
+    Uniforms,
+    Draw,
+    Swap,
+    Poll,
+    Count,
+};
+constexpr int N_FRAME_PHASE = (int)FramePhase::Count;
+
+[[nodiscard]] const char *frame_phase_name(FramePhase phase) noexcept;
+
+struct FrameRecord
+{
+    unsigned long frame;
+    std::array<double, N_FRAME_PHASE> cpu_ms;
+    double cpu_total_ms;
+    double gpu_ms; // Negative until the timer query result came back
+};
+
+struct PercentileSummary
+{
+    double p50;
+    double p95;
+    double p99;
+};
+
+struct ProfileSummary
+{
+    size_t n_frames;
+    size_t n_gpu_frames;
+    std::array<PercentileSummary, N_FRAME_PHASE> cpu_ms;
+    PercentileSummary cpu_total_ms;
+    PercentileSummary gpu_ms;
+};
+
+// Per frame CPU time by phase, plus GPU time from a ring of GL_TIME_ELAPSED queries.
+// Query results are only collected once available, the profiler never waits on the GPU.
+class FrameProfiler
+{
+private:
+    using Clock = std::chrono::steady_clock;
+
+    bool m_gpu;
+    std::vector<unsigned int> m_queries;
+    std::vector<long> m_query_frame; // Frame the query measures, -1 when free
+    size_t m_query_head;
+    std::vector<FrameRecord> m_records; // Ring indexed by frame number
+    unsigned long m_frame;
+    bool m_in_frame;
+    int m_phase;
+    Clock::time_point m_frame_start;
+    Clock::time_point m_phase_start;
+
+    void collect_queries() noexcept;
+
+public:
+    // GPU timing needs the GL context current for the whole lifetime
+    explicit FrameProfiler(bool gpu_timing);
+    FrameProfiler(const FrameProfiler &) = delete;
+    FrameProfiler &operator=(const FrameProfiler &) = delete;
+    ~FrameProfiler();
+
+    void begin_frame() noexcept;
+    // Ends the running phase and starts the given one
+    void phase(FramePhase phase) noexcept;
+    void end_frame() noexcept;
+
+    // Most recent frames, oldest first
+    [[nodiscard]] std::vector<FrameRecord> records() const;
+    [[nodiscard]] ProfileSummary summary() const;
+
+    [[nodiscard]] constexpr unsigned long n_frames() const noexcept
+    {
+        return m_frame;
+    }
+};
@@ -0,0 +1,140 @@
+#include <glad/glad.h>
+#include <cstdint>
+#include <iterator>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "program_cache.h"
+#include "gl_ext.h"
+#include "hash.h"
+#include "trace.h"
+
+constexpr uint32_t PROGRAM_CACHE_MAGIC = 0x50524742; // "PRGB"
+
+struct ProgramCacheHeader
+{
+    uint32_t magic;
+    uint32_t format;
+    uint64_t key;
+};
+
+static uint64_t hash_gl_string(GLenum name, uint64_t seed) noexcept
+{
+    const char *value = (const char *)glGetString(name);
+    return hash64(value ? value : "", seed);
+}
+
+ProgramCache::ProgramCache(const std::filesystem::path &dir)
+    : m_dir(dir), m_driver_hash(HASH64_SEED), m_supported(false), m_stats{0, 0, 0}
+{
+    int n_formats = 0;
+    if (gl_ext_get_program_binary && gl_ext_program_binary && gl_ext_program_parameteri)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+    m_supported = n_formats > 0;
+
+    // Binaries are only valid for the exact driver that produced them
+    m_driver_hash = hash_gl_string(GL_VENDOR, m_driver_hash);
+    m_driver_hash = hash_gl_string(GL_RENDERER, m_driver_hash);
+    m_driver_hash = hash_gl_string(GL_VERSION, m_driver_hash);
+}
+
+std::filesystem::path ProgramCache::path(uint64_t key) const
+{
+    return m_dir / std::format("{:016x}.bin", key);
+}
+
+uint64_t program_source_hash(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info)
+{
+    std::vector<uint64_t> v_hashes, f_hashes;
+    for (std::string_view source : v_info)
+        v_hashes.push_back(hash64(source));
+    for (std::string_view source : f_info)
+        f_hashes.push_back(hash64(source));
+    return program_source_hash(v_hashes, f_hashes);
+}
+
+uint64_t ProgramCache::key(uint64_t source_hash) const noexcept
+{
+    return hash64_combine(source_hash, m_driver_hash);
+}
+
+unsigned int ProgramCache::load(uint64_t key)
+{
+    if (!m_supported)
+        return 0;
+    TRACE_SCOPE("program_cache load");
+
+    std::ifstream in(path(key), std::ios::binary);
+    if (!in)
+        return 0;
+
+    ProgramCacheHeader header;
+    if (!in.read((char *)&header, sizeof(header)) || header.magic != PROGRAM_CACHE_MAGIC || header.key != key)
+        return 0;
+    std::vector<char> binary((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    unsigned int program = glCreateProgram();
+    if (!program)
+        return 0;
+    gl_ext_program_binary(program, header.format, binary.data(), binary.size());
+
+    // The driver may reject binaries after an update, drop the file and compile instead
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glDeleteProgram(program);
+        std::error_code ec;
+        std::filesystem::remove(path(key), ec);
+        m_stats.rejected++;
+        return 0;
+    }
+
+    m_stats.hits++;
+    return program;
+}
+
+void ProgramCache::prepare(unsigned int program) noexcept
+{
+    if (m_supported)
+        gl_ext_program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+void ProgramCache::store(uint64_t key, unsigned int program)
+{
+    if (!m_supported)
+        return;
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    ProgramCacheHeader header{PROGRAM_CACHE_MAGIC, 0, key};
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    gl_ext_get_program_binary(program, length, &length, &format, binary.data());
+    header.format = format;
+
+    // A missing cache is never an error, failing to write one is not either
+    std::error_code ec;
+    std::filesystem::create_directories(m_dir, ec);
+    if (ec)
+        return;
+
+    // Write then rename, concurrent runs never see a partial file
+    std::filesystem::path final_path = path(key);
+    std::filesystem::path tmp_path = final_path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!out.write((const char *)&header, sizeof(header)) || !out.write(binary.data(), length))
+            return;
+    }
+    std::filesystem::rename(tmp_path, final_path, ec);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+
+#include "hash.h"
+
+struct ProgramCacheStats
+{
+    unsigned long hits;     // Programs restored with glProgramBinary
+    unsigned long compiles; // Programs compiled and linked from source
+    unsigned long rejected; // Binaries the driver refused, followed by a compile
+};
+
+// Identifies a program's sources from the hash64 of every source, stage by stage. Embedded shaders
+// come with their hashes, so their program's hash is a compile-time constant.
+[[nodiscard]] constexpr uint64_t program_source_hash(const std::span<const uint64_t> v_hashes, const std::span<const uint64_t> f_hashes) noexcept
+{
+    uint64_t hash = HASH64_SEED;
+    for (auto stage : {v_hashes, f_hashes})
+    {
+        // Stage length first, so moving a source between stages changes the hash
+        hash = hash64_combine(stage.size(), hash);
+        for (uint64_t source : stage)
+            hash = hash64_combine(source, hash);
+    }
+    return hash;
+}
+
+// Same, hashing the sources now
+[[nodiscard]] uint64_t program_source_hash(const std::span<const std::string_view> v_info, const std::span<const std::string_view> f_info);
+
+// Persists glGetProgramBinary output on disk, keyed by the shader sources and the driver strings.
+// Does nothing when neither GL 4.1 nor ARB_get_program_binary is available.
+class ProgramCache
+{
+private:
+    std::filesystem::path m_dir;
+    uint64_t m_driver_hash;
+    bool m_supported;
+    ProgramCacheStats m_stats;
+
+    [[nodiscard]] std::filesystem::path path(uint64_t key) const;
+
+public:
+    // Needs a current context with gl_ext_load done
+    explicit ProgramCache(const std::filesystem::path &dir);
+
+    // Adds the driver strings to a program_source_hash
+    [[nodiscard]] uint64_t key(uint64_t source_hash) const noexcept;
+
+    // Returns a linked program, or 0 when there is no usable binary for the key
+    [[nodiscard]] unsigned int load(uint64_t key);
+
+    // Must be called on a fresh program before glLinkProgram
+    void prepare(unsigned int program) noexcept;
+    void store(uint64_t key, unsigned int program);
+
+    void count_compile() noexcept
+    {
+        m_stats.compiles++;
+    }
+
+    [[nodiscard]] constexpr bool supported() const noexcept
+    {
+        return m_supported;
+    }
+
+    [[nodiscard]] constexpr const ProgramCacheStats &stats() const noexcept
+    {
+        return m_stats;
+    }
+};
@@ -0,0 +1,292 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "raster.h"
+#include "constant.h"
+
+// Split [0, n) into n_chunks contiguous chunks, keeps primitive order within and across chunks
+static void chunk_range(size_t n, unsigned int chunk, unsigned int n_chunks, size_t *begin, size_t *end) noexcept
+{
+    size_t size = (n + n_chunks - 1) / n_chunks;
+    *begin = std::min(n, size * chunk);
+    *end = std::min(n, *begin + size);
+}
+
+static inline uint32_t pack_color(float r, float g, float b, float a) noexcept
+{
+    auto to_unorm = [](float v)
+    { return (uint32_t)(std::clamp(v, 0.f, 1.f) * 255.f + 0.5f); };
+    return to_unorm(r) | to_unorm(g) << 8 | to_unorm(b) << 16 | to_unorm(a) << 24;
+}
+
+Rasterizer::Rasterizer(int width, int height, JobSystem &jobs)
+    : m_width(width),
+      m_height(height),
+      m_tiles_x((width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE),
+      m_tiles_y((height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE),
+      m_stride(m_tiles_x * RASTER_TILE_SIZE),
+      m_color((size_t)m_stride * m_tiles_y * RASTER_TILE_SIZE),
+      m_jobs(jobs)
+{
+    if (width <= 0 || height <= 0)
+        throw std::runtime_error("Invalid rasterizer dimensions");
+
+    m_bins.resize(m_jobs.size());
+    for (auto &bins : m_bins)
+        bins.resize(m_tiles_x * m_tiles_y);
+}
+
+void Rasterizer::use_vertices(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements)
+{
+    m_vertices.assign(vertices.begin(), vertices.end());
+    m_elements.assign(elements.begin(), elements.end());
+}
+
+void Rasterizer::clear(float r, float g, float b, float a) noexcept
+{
+    uint32_t color = pack_color(r, g, b, a);
+    m_jobs.parallel_for(m_bins.size(), 1, [&](size_t chunk, size_t, unsigned int)
+                        {
+                            size_t begin, end;
+                            chunk_range(m_color.size(), chunk, m_bins.size(), &begin, &end);
+                            std::fill(m_color.begin() + begin, m_color.begin() + end, color); });
+}
+
+void Rasterizer::shade_vertices(unsigned int chunk, const RasterUniforms &uniforms) noexcept
+{
+    // Instance major, vertex i of instance n lands at n * n_vertices + i
+    size_t begin, end;
+    chunk_range(m_screen.size(), chunk, m_bins.size(), &begin, &end);
+    for (size_t i = begin; i < end; i++)
+    {
+        // vertex.glsl
+        const Vec3f &pos = m_draw_vertices[i % m_draw_vertices.size()];
+        const InstanceData &instance = m_draw_instances[i / m_draw_vertices.size()];
+        const ObjectUniforms &object = uniforms.object;
+        float ndc_x = (pos.x * instance.scale + instance.offset[0]) * object.scale + object.offset[0] + uniforms.pos_offset;
+        float ndc_y = (pos.y * instance.scale + instance.offset[1]) * object.scale + object.offset[1] + uniforms.pos_offset;
+
+        // Viewport transform, y points up like the GL window space
+        ScreenVertex &out = m_screen[i];
+        out.x = (ndc_x + 1.f) * 0.5f * m_width;
+        out.y = (ndc_y + 1.f) * 0.5f * m_height;
+        out.r = (pos.x * 2 + 1 + uniforms.color_offset) / 3 * (instance.color[0] * object.color[0]);
+        out.g = (pos.y * 2 + 1 + uniforms.color_offset) / 3 * (instance.color[1] * object.color[1]);
+        out.b = (pos.z * 2 + 1 + uniforms.color_offset) / 3 * (instance.color[2] * object.color[2]);
+    }
+}
+
+void Rasterizer::setup_triangles(unsigned int chunk) noexcept
+{
+    auto &bins = m_bins[chunk];
+    for (auto &bin : bins)
+        bin.clear();
+
+    // Triangle t is triangle t % n_mesh of instance t / n_mesh, which is the GL primitive order
+    size_t n_mesh = m_draw_elements.size() / 3, n_vertices = m_draw_vertices.size();
+    size_t begin, end;
+    chunk_range(m_triangles.size(), chunk, m_bins.size(), &begin, &end);
+    for (size_t t = begin; t < end; t++)
+    {
+        const unsigned int *element = &m_draw_elements[(t % n_mesh) * 3];
+        if (element[0] >= n_vertices || element[1] >= n_vertices || element[2] >= n_vertices)
+            continue;
+        const ScreenVertex *instance = &m_screen[(t / n_mesh) * n_vertices];
+        const ScreenVertex *v[3] = {&instance[element[0]], &instance[element[1]], &instance[element[2]]};
+
+        // No culling in the GL pipeline, bring every triangle to counter clockwise order
+        float area = (v[1]->x - v[0]->x) * (v[2]->y - v[0]->y) - (v[1]->y - v[0]->y) * (v[2]->x - v[0]->x);
+        if (area == 0.f)
+            continue;
+        if (area < 0.f)
+        {
+            std::swap(v[1], v[2]);
+            area = -area;
+        }
+
+        // Bounding box of covered pixel centers, clipped to the screen
+        Triangle &tri = m_triangles[t];
+        float min_x = std::min({v[0]->x, v[1]->x, v[2]->x}), max_x = std::max({v[0]->x, v[1]->x, v[2]->x});
+        float min_y = std::min({v[0]->y, v[1]->y, v[2]->y}), max_y = std::max({v[0]->y, v[1]->y, v[2]->y});
+        tri.min_x = std::max(0, (int)std::floor(min_x));
+        tri.min_y = std::max(0, (int)std::floor(min_y));
+        tri.max_x = std::min(m_width - 1, (int)std::ceil(max_x));
+        tri.max_y = std::min(m_height - 1, (int)std::ceil(max_y));
+        if (tri.min_x > tri.max_x || tri.min_y > tri.max_y)
+            continue;
+
+        // Edge i is opposite to vertex i, its value is the barycentric weight of vertex i times the area
+        float inv_area = 1.f / area;
+        float weight_a[3], weight_b[3], weight_c[3];
+        for (int e = 0; e < 3; e++)
+        {
+            const ScreenVertex &a = *v[(e + 1) % 3];
+            const ScreenVertex &b = *v[(e + 2) % 3];
+            tri.edge_a[e] = a.y - b.y;
+            tri.edge_b[e] = b.x - a.x;
+            tri.edge_c[e] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+
+            // Top-left rule, a shared edge is owned by exactly one of its triangles
+            tri.edge_inclusive[e] = tri.edge_a[e] > 0.f || (tri.edge_a[e] == 0.f && tri.edge_b[e] < 0.f);
+
+            weight_a[e] = tri.edge_a[e] * inv_area;
+            weight_b[e] = tri.edge_b[e] * inv_area;
+            weight_c[e] = tri.edge_c[e] * inv_area;
+        }
+
+        // Color planes, vertexColor interpolated over the triangle
+        const float ScreenVertex::*channels[3] = {&ScreenVertex::r, &ScreenVertex::g, &ScreenVertex::b};
+        for (int c = 0; c < 3; c++)
+        {
+            float c0 = v[0]->*channels[c], c1 = v[1]->*channels[c], c2 = v[2]->*channels[c];
+            tri.color_a[c] = weight_a[0] * c0 + weight_a[1] * c1 + weight_a[2] * c2;
+            tri.color_b[c] = weight_b[0] * c0 + weight_b[1] * c1 + weight_b[2] * c2;
+            tri.color_c[c] = weight_c[0] * c0 + weight_c[1] * c1 + weight_c[2] * c2;
+        }
+
+        // Bin into every overlapped tile
+        for (int ty = tri.min_y / RASTER_TILE_SIZE; ty <= tri.max_y / RASTER_TILE_SIZE; ty++)
+            for (int tx = tri.min_x / RASTER_TILE_SIZE; tx <= tri.max_x / RASTER_TILE_SIZE; tx++)
+                bins[ty * m_tiles_x + tx].push_back(t);
+    }
+}
+
+#ifdef __SSE2__
+static inline __m128 edge_mask(__m128 value, bool inclusive) noexcept
+{
+    return inclusive ? _mm_cmpge_ps(value, _mm_setzero_ps()) : _mm_cmpgt_ps(value, _mm_setzero_ps());
+}
+
+static inline __m128i to_unorm8(__m128 value) noexcept
+{
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.f));
+    return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, _mm_set1_ps(255.f)), _mm_set1_ps(0.5f)));
+}
+#endif
+
+void Rasterizer::raster_tile(int tile) noexcept
+{
+    int tile_x0 = (tile % m_tiles_x) * RASTER_TILE_SIZE;
+    int tile_y0 = (tile / m_tiles_x) * RASTER_TILE_SIZE;
+
+    // Walk the per-chunk bins in chunk order, which is primitive order
+    for (const auto &chunk_bins : m_bins)
+    {
+        for (uint32_t t : chunk_bins[tile])
+        {
+            const Triangle &tri = m_triangles[t];
+            int x0 = std::max(tri.min_x, tile_x0) & ~3;
+            int x1 = std::min(tri.max_x, tile_x0 + RASTER_TILE_SIZE - 1);
+            int y0 = std::max(tri.min_y, tile_y0);
+            int y1 = std::min(tri.max_y, tile_y0 + RASTER_TILE_SIZE - 1);
+
+            for (int y = y0; y <= y1; y++)
+            {
+                float py = y + 0.5f;
+                uint32_t *row = m_color.data() + (size_t)y * m_stride;
+
+#ifdef __SSE2__
+                __m128 vy = _mm_set1_ps(py);
+                for (int x = x0; x <= x1; x += 4)
+                {
+                    // Evaluate everything directly at the pixel centers so results do not depend on tiling
+                    __m128 vx = _mm_add_ps(_mm_set1_ps((float)x), _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f));
+                    __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int e = 0; e < 3; e++)
+                    {
+                        __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.edge_a[e]), vx),
+                                                         _mm_mul_ps(_mm_set1_ps(tri.edge_b[e]), vy)),
+                                              _mm_set1_ps(tri.edge_c[e]));
+                        mask = _mm_and_ps(mask, edge_mask(w, tri.edge_inclusive[e]));
+                    }
+                    if (_mm_movemask_ps(mask) == 0)
+                        continue;
+
+                    // frag.glsl, FragColor = vertexColor
+                    __m128i rgba = _mm_set1_epi32((int)0xFF000000);
+                    for (int c = 0; c < 3; c++)
+                    {
+                        __m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(tri.color_a[c]), vx),
+                                                             _mm_mul_ps(_mm_set1_ps(tri.color_b[c]), vy)),
+                                                  _mm_set1_ps(tri.color_c[c]));
+                        rgba = _mm_or_si128(rgba, _mm_slli_epi32(to_unorm8(value), c * 8));
+                    }
+
+                    __m128i *dst = (__m128i *)(row + x);
+                    __m128i covered = _mm_castps_si128(mask);
+                    __m128i old = _mm_loadu_si128(dst);
+                    _mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(covered, rgba), _mm_andnot_si128(covered, old)));
+                }
+#else
+                for (int x = x0; x <= x1; x++)
+                {
+                    float px = x + 0.5f;
+                    bool inside = true;
+                    for (int e = 0; e < 3 && inside; e++)
+                    {
+                        float w = tri.edge_a[e] * px + tri.edge_b[e] * py + tri.edge_c[e];
+                        inside = tri.edge_inclusive[e] ? w >= 0.f : w > 0.f;
+                    }
+                    if (!inside)
+                        continue;
+
+                    float rgb[3];
+                    for (int c = 0; c < 3; c++)
+                        rgb[c] = tri.color_a[c] * px + tri.color_b[c] * py + tri.color_c[c];
+                    row[x] = pack_color(rgb[0], rgb[1], rgb[2], 1.f);
+                }
+#endif
+            }
+        }
+    }
+}
+
+void Rasterizer::draw(const RasterUniforms &uniforms, const std::span<const InstanceData> instances) noexcept
+{
+    draw(uniforms, m_vertices, m_elements, instances);
+}
+
+void Rasterizer::draw(const RasterUniforms &uniforms, const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements,
+                      const std::span<const InstanceData> instances) noexcept
+{
+    if (vertices.empty() || elements.size() < 3)
+        return;
+
+    m_draw_vertices = vertices;
+    m_draw_elements = elements;
+    m_draw_instances = instances.empty() ? std::span<const InstanceData>(&INSTANCE_IDENTITY, 1) : instances;
+    m_screen.resize(vertices.size() * m_draw_instances.size());
+    m_triangles.resize(elements.size() / 3 * m_draw_instances.size());
+
+    // Geometry, one contiguous range of vertices and triangles per chunk
+    m_jobs.parallel_for(m_bins.size(), 1, [&](size_t chunk, size_t, unsigned int)
+                        { shade_vertices(chunk, uniforms); });
+    m_jobs.parallel_for(m_bins.size(), 1, [&](size_t chunk, size_t, unsigned int)
+                        { setup_triangles(chunk); });
+
+    // Pixels, a job per chunk pulling tiles until none are left. Cheaper than a job per tile for
+    // the many small draws that only touch a few of them.
+    std::atomic<int> next_tile = 0;
+    int n_tiles = m_tiles_x * m_tiles_y;
+    m_jobs.parallel_for(m_bins.size(), 1, [&](size_t, size_t, unsigned int)
+                        {
+                            for (int tile = next_tile++; tile < n_tiles; tile = next_tile++)
+                                raster_tile(tile); });
+}
+
+std::vector<unsigned char> Rasterizer::read_pixels() const
+{
+    std::vector<unsigned char> pixels((size_t)m_width * m_height * 4);
+    for (int y = 0; y < m_height; y++)
+        memcpy(pixels.data() + (size_t)y * m_width * 4, m_color.data() + (size_t)y * m_stride, (size_t)m_width * 4);
+    return pixels;
+}
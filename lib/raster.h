@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "app.h"
+#include "job_system.h"
+
+// Uniforms of shaders/vertex.glsl
+struct RasterUniforms
+{
+    float color_offset;
+    float pos_offset;
+    ObjectUniforms object = OBJECT_IDENTITY;
+};
+
+// CPU implementation of the shaders/vertex.glsl + shaders/frag.glsl pipeline.
+// Triangles are binned into screen tiles, tiles are shaded in parallel with SIMD edge functions.
+// Work is split into one chunk per job worker and run on the JobSystem. Output only depends on the
+// input, never on the number of workers.
+class Rasterizer
+{
+private:
+    struct ScreenVertex
+    {
+        float x, y;
+        float r, g, b;
+    };
+
+    // Edge functions and color planes, all of the form a * x + b * y + c
+    struct Triangle
+    {
+        float edge_a[3], edge_b[3], edge_c[3];
+        bool edge_inclusive[3];
+        float color_a[3], color_b[3], color_c[3];
+        int min_x, min_y, max_x, max_y;
+    };
+
+    int m_width;
+    int m_height;
+    int m_tiles_x;
+    int m_tiles_y;
+    int m_stride;
+    std::vector<uint32_t> m_color;
+    std::vector<Vec3f> m_vertices;
+    std::vector<unsigned int> m_elements;
+    std::span<const Vec3f> m_draw_vertices;
+    std::span<const unsigned int> m_draw_elements;
+    std::span<const InstanceData> m_draw_instances; // Never empty during a draw
+    std::vector<ScreenVertex> m_screen;
+    std::vector<Triangle> m_triangles;
+    std::vector<std::vector<std::vector<uint32_t>>> m_bins; // [chunk][tile] -> triangle ids
+    JobSystem &m_jobs;
+
+    void shade_vertices(unsigned int chunk, const RasterUniforms &uniforms) noexcept;
+    void setup_triangles(unsigned int chunk) noexcept;
+    void raster_tile(int tile) noexcept;
+
+public:
+    // Jobs are queued from the thread drawing, which must be a worker of `jobs`
+    Rasterizer(int width, int height, JobSystem &jobs);
+
+    void use_vertices(const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements);
+    void clear(float r, float g, float b, float a) noexcept;
+    // Whether use_vertices stored a mesh that draw can rasterize
+    [[nodiscard]] bool has_vertices() const noexcept
+    {
+        return !m_vertices.empty() && m_elements.size() >= 3;
+    }
+    // The stored mesh once per instance, in instance order, or once when `instances` is empty
+    void draw(const RasterUniforms &uniforms, const std::span<const InstanceData> instances = {}) noexcept;
+    // Transient geometry, not kept after the call
+    void draw(const RasterUniforms &uniforms, const std::span<const Vec3f> vertices, const std::span<const unsigned int> elements,
+              const std::span<const InstanceData> instances = {}) noexcept;
+
+    // Same layout as App::read_pixels, tightly packed RGBA8 rows, bottom row first
+    [[nodiscard]] std::vector<unsigned char> read_pixels() const;
+
+    [[nodiscard]] unsigned int n_workers() const noexcept
+    {
+        return m_jobs.size();
+    }
+};
@@ -0,0 +1,82 @@
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+#include "render_queue.h"
+
+constexpr int RENDER_KEY_DEPTH_BITS = 22;
+constexpr int RENDER_KEY_STATE_BITS = 12;
+constexpr int RENDER_KEY_MATERIAL_BITS = 16;
+
+uint64_t render_key(RenderPass pass, unsigned int program, unsigned int vao, uint32_t material, float depth) noexcept
+{
+    // Negative and NaN depths sort first, the sign bit is then always clear and dropped
+    if (!(depth > 0.f))
+        depth = 0.f;
+    uint64_t depth_bits = std::bit_cast<uint32_t>(depth) >> (31 - RENDER_KEY_DEPTH_BITS);
+    uint64_t state = (uint64_t)(program & ((1u << RENDER_KEY_STATE_BITS) - 1)) << (RENDER_KEY_STATE_BITS + RENDER_KEY_MATERIAL_BITS) |
+                     (uint64_t)(vao & ((1u << RENDER_KEY_STATE_BITS) - 1)) << RENDER_KEY_MATERIAL_BITS |
+                     (material & ((1u << RENDER_KEY_MATERIAL_BITS) - 1));
+    uint64_t key = (uint64_t)pass << 62;
+
+    if (pass == RenderPass::Transparent)
+    {
+        uint64_t far_first = ~depth_bits & ((1u << RENDER_KEY_DEPTH_BITS) - 1);
+        return key | far_first << (2 * RENDER_KEY_STATE_BITS + RENDER_KEY_MATERIAL_BITS) | state;
+    }
+    return key | state << RENDER_KEY_DEPTH_BITS | depth_bits;
+}
+
+void RenderQueue::submit(const DrawItem &item, uint64_t key)
+{
+    m_order.push_back(m_items.size());
+    m_items.push_back(item);
+    m_keys.push_back(key);
+}
+
+void RenderQueue::sort() noexcept
+{
+    size_t n = m_keys.size();
+    if (n < 2)
+        return;
+    m_scratch_keys.resize(n);
+    m_scratch_order.resize(n);
+
+    // Every digit's histogram in one read of the keys
+    std::array<std::array<uint32_t, 256>, 8> counts{};
+    for (uint64_t key : m_keys)
+        for (int digit = 0; digit < 8; digit++)
+            counts[digit][(key >> (digit * 8)) & 0xFF]++;
+
+    for (int digit = 0; digit < 8; digit++)
+    {
+        int shift = digit * 8;
+        if (counts[digit][(m_keys[0] >> shift) & 0xFF] == n)
+            continue;
+
+        // Stable scatter, equal keys keep submission order
+        std::array<uint32_t, 256> offsets;
+        uint32_t sum = 0;
+        for (int bucket = 0; bucket < 256; bucket++)
+        {
+            offsets[bucket] = sum;
+            sum += counts[digit][bucket];
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            uint32_t dst = offsets[(m_keys[i] >> shift) & 0xFF]++;
+            m_scratch_keys[dst] = m_keys[i];
+            m_scratch_order[dst] = m_order[i];
+        }
+        std::swap(m_keys, m_scratch_keys);
+        std::swap(m_order, m_scratch_order);
+    }
+}
+
+void RenderQueue::clear() noexcept
+{
+    m_items.clear();
+    m_keys.clear();
+    m_order.clear();
+}
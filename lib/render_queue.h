@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "mesh.h"
+
+enum class RenderPass : uint8_t
+{
+    Opaque,      // Grouped by state, front to back within a state
+    Transparent, // Back to front, state only breaks depth ties
+};
+
+// One queued draw, everything update() needs to issue it
+struct DrawItem
+{
+    MeshRange range;
+    unsigned int program; // 0 for the program current when drawn
+    unsigned int vao;
+    uint32_t material;
+    size_t object; // Index of the frame's staged ObjectData block, NO_OBJECT for identity
+};
+
+constexpr size_t NO_OBJECT = SIZE_MAX;
+
+// State changes the last flushed queue needed, the sort tries to keep them near the unique counts
+struct RenderQueueStats
+{
+    size_t draws;
+    size_t program_changes;
+    size_t vao_changes;
+    size_t material_changes;
+};
+
+// 64-bit key, most significant first:
+//   opaque      pass:2 program:12 vao:12 material:16 depth:22
+//   transparent pass:2 ~depth:22 program:12 vao:12 material:16
+// Program and VAO names are truncated to 12 bits, a collision only costs grouping, never correctness.
+// Depth is the top of the float's bit pattern, which orders like the value for depth >= 0.
+[[nodiscard]] uint64_t render_key(RenderPass pass, unsigned int program, unsigned int vao, uint32_t material, float depth) noexcept;
+
+// Draws of one frame sorted by key with an LSD radix sort, 8 bits per pass. Passes where every key
+// has the same digit are skipped, so keys differing only in low fields cost a few passes.
+class RenderQueue
+{
+private:
+    std::vector<DrawItem> m_items;
+    std::vector<uint64_t> m_keys;
+    std::vector<uint32_t> m_order; // Item indices, sorted by sort()
+    std::vector<uint64_t> m_scratch_keys;
+    std::vector<uint32_t> m_scratch_order;
+
+public:
+    void submit(const DrawItem &item, uint64_t key);
+    void sort() noexcept;
+    void clear() noexcept;
+
+    // Submission order until sort()
+    [[nodiscard]] std::span<const uint32_t> order() const noexcept
+    {
+        return m_order;
+    }
+
+    [[nodiscard]] const DrawItem &item(uint32_t index) const noexcept
+    {
+        return m_items[index];
+    }
+
+    [[nodiscard]] size_t size() const noexcept
+    {
+        return m_items.size();
+    }
+};
@@ -0,0 +1,78 @@
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <utility>
+
+#include "render_thread.h"
+#include "trace.h"
+
+RenderThread::RenderThread(const Context &context)
+    : m_context(context), m_posted(0), m_done(0), m_stop(false)
+{
+    m_thread = std::thread(&RenderThread::run, this);
+    try
+    {
+        call([this]
+             { m_context.make_current(); });
+    }
+    catch (...)
+    {
+        post([this]
+             { m_stop = true; });
+        m_thread.join();
+        throw;
+    }
+}
+
+RenderThread::~RenderThread()
+{
+    post([this]
+         {
+             m_context.release();
+             m_stop = true; });
+    m_thread.join();
+}
+
+void RenderThread::run() noexcept
+{
+    TRACE_THREAD_NAME("render");
+    while (!m_stop)
+    {
+        Command command = m_commands.pop();
+        command();
+        m_done.fetch_add(1, std::memory_order_release);
+        m_done.notify_all();
+    }
+}
+
+void RenderThread::post(Command command)
+{
+    m_commands.push(std::move(command));
+    m_posted++;
+}
+
+void RenderThread::wait() const noexcept
+{
+    unsigned long done;
+    while ((done = m_done.load(std::memory_order_acquire)) < m_posted)
+        m_done.wait(done, std::memory_order_acquire);
+}
+
+void RenderThread::call(const std::function<void()> &command)
+{
+    std::exception_ptr error;
+    post([&]
+         {
+             try
+             {
+                 command();
+             }
+             catch (...)
+             {
+                 error = std::current_exception();
+             } });
+    wait();
+    if (error)
+        std::rethrow_exception(error);
+}
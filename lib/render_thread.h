@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "constant.h"
+#include "context.h"
+#include "spsc_queue.h"
+
+// Thread owning a GL context, runs the commands of one producer thread in order
+class RenderThread
+{
+public:
+    using Command = std::function<void()>;
+
+private:
+    const Context &m_context;
+    SpscQueue<Command, RENDER_THREAD_COMMANDS> m_commands;
+    unsigned long m_posted;            // Producer only
+    std::atomic<unsigned long> m_done; // Commands run so far
+    bool m_stop;                       // Render thread only
+    std::thread m_thread;
+
+    void run() noexcept;
+
+public:
+    // Makes `context` current on the new thread, it must not be current anywhere else
+    explicit RenderThread(const Context &context);
+    RenderThread(const RenderThread &) = delete;
+    RenderThread &operator=(const RenderThread &) = delete;
+    // Runs what is queued, then releases the context so another thread can take it back
+    ~RenderThread();
+
+    // Queue `command` and return, only blocks while the queue is full. It must not throw.
+    void post(Command command);
+    // Wait until every command posted so far ran
+    void wait() const noexcept;
+    // Run `command` on the render thread and wait for it, its exception is rethrown here
+    void call(const std::function<void()> &command);
+
+    // Whether the caller is the render thread
+    [[nodiscard]] bool current() const noexcept
+    {
+        return std::this_thread::get_id() == m_thread.get_id();
+    }
+};
@@ -0,0 +1,43 @@
+// Generated by tools/shader_codegen.cpp from frag.glsl vertex.glsl, do not edit
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace shaders
+{
+// layout (std140) uniform FrameData in shaders/vertex.glsl
+struct FrameData
+{
+    float color_offset;
+    float pos_offset;
+    float pad0[2];
+};
+static_assert(sizeof(FrameData) == 16);
+static_assert(offsetof(FrameData, color_offset) == 0);
+static_assert(offsetof(FrameData, pos_offset) == 4);
+constexpr unsigned int FRAME_DATA_BINDING = 0;
+constexpr const char *FRAME_DATA_NAME = "FrameData";
+
+// layout (std140) uniform ObjectData in shaders/vertex.glsl
+struct ObjectData
+{
+    float object_offset[4];
+    float object_color[4];
+};
+static_assert(sizeof(ObjectData) == 32);
+static_assert(offsetof(ObjectData, object_offset) == 0);
+static_assert(offsetof(ObjectData, object_color) == 16);
+constexpr unsigned int OBJECT_DATA_BINDING = 1;
+constexpr const char *OBJECT_DATA_NAME = "ObjectData";
+
+constexpr const char *UNIFORM_BLOCK_NAMES[] = {"FrameData", "ObjectData"};
+
+namespace vertex
+{
+constexpr unsigned int A_POS_LOCATION = 0; // in vec3 aPos
+constexpr unsigned int A_INSTANCE_LOCATION = 4; // in vec4 aInstance
+constexpr unsigned int A_INSTANCE_COLOR_LOCATION = 5; // in vec4 aInstanceColor
+} // namespace vertex
+
+} // namespace shaders
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <filesystem>
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "shader_preprocessor.h"
+#include "file.h"
+#include "hash.h"
+#include "program_cache.h"
+
+// Directive name of a preprocessor line, e.g. "include" for `  #  include "a.glsl"`, empty otherwise
+static std::string_view directive(std::string_view line, std::string_view &rest) noexcept
+{
+    size_t i = line.find_first_not_of(" \t");
+    if (i == std::string_view::npos || line[i] != '#')
+        return {};
+    i = line.find_first_not_of(" \t", i + 1);
+    if (i == std::string_view::npos)
+        return {};
+    size_t end = i;
+    while (end < line.size() && isalpha((unsigned char)line[end]))
+        end++;
+    rest = line.substr(end);
+    return line.substr(i, end - i);
+}
+
+// Whole identifier match, so FOO does not match FOO_BAR
+static bool mentions(std::string_view text, std::string_view name) noexcept
+{
+    auto identifier = [](char c)
+    { return isalnum((unsigned char)c) || c == '_'; };
+    for (size_t i = text.find(name); i != std::string_view::npos; i = text.find(name, i + 1))
+    {
+        bool before = i > 0 && identifier(text[i - 1]);
+        bool after = i + name.size() < text.size() && identifier(text[i + name.size()]);
+        if (!before && !after)
+            return true;
+    }
+    return false;
+}
+
+const std::string &ShaderPreprocessor::file(const std::string &path)
+{
+    auto it = m_files.find(path);
+    if (it == m_files.end())
+    {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error))
+            throw std::runtime_error(std::format("Shader source {} not found", path));
+        it = m_files.emplace(path, read_file(path)).first;
+    }
+    return it->second;
+}
+
+void ShaderPreprocessor::include(const std::string &path, ExpandedShader &out, std::vector<std::string> &stack, std::vector<std::string> &once, std::string &version)
+{
+    if (std::find(stack.begin(), stack.end(), path) != stack.end())
+        throw std::runtime_error(std::format("Include cycle through {}", path));
+    if (std::find(once.begin(), once.end(), path) != once.end())
+        return;
+
+    const std::string &source = file(path);
+    size_t index = out.files.size();
+    out.files.push_back(path);
+    stack.push_back(path);
+    out.text += std::format("#line 1 {}\n", index);
+
+    std::string_view text = source;
+    int line_number = 0;
+    while (!text.empty())
+    {
+        size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+        line_number++;
+
+        std::string_view rest;
+        std::string_view name = directive(line, rest);
+        if (name == "version")
+        {
+            // Kept aside, it must stay the first line of the expanded source
+            if (stack.size() > 1 || !version.empty())
+                throw std::runtime_error(std::format("{}:{}: #version is only allowed once, in the root file", path, line_number));
+            version = line;
+            out.text += '\n';
+        }
+        else if (name == "include")
+        {
+            size_t open = rest.find('"');
+            size_t close = open == std::string_view::npos ? open : rest.find('"', open + 1);
+            if (close == std::string_view::npos)
+                throw std::runtime_error(std::format("{}:{}: expected #include \"path\"", path, line_number));
+            std::filesystem::path target = std::filesystem::path(path).parent_path() / rest.substr(open + 1, close - open - 1);
+            include(target.lexically_normal().generic_string(), out, stack, once, version);
+            out.text += std::format("#line {} {}\n", line_number + 1, index);
+        }
+        else if (name == "pragma" && rest.find("once") != std::string_view::npos)
+        {
+            once.push_back(path);
+            out.text += '\n';
+        }
+        else
+        {
+            out.text += line;
+            out.text += '\n';
+        }
+    }
+    stack.pop_back();
+}
+
+ExpandedShader ShaderPreprocessor::expand(std::string_view path, std::span<const ShaderDefine> defines)
+{
+    // Includes first, the defines depend on what ends up in the source
+    ExpandedShader body{"", 0, {}};
+    std::vector<std::string> stack, once;
+    std::string version;
+    include(std::filesystem::path(path).lexically_normal().generic_string(), body, stack, once, version);
+
+    // Sorted, so the same set in any order expands to the same text
+    std::vector<ShaderDefine> used;
+    for (const ShaderDefine &define : defines)
+        if (mentions(body.text, define.name))
+            used.push_back(define);
+    std::sort(used.begin(), used.end(), [](const ShaderDefine &a, const ShaderDefine &b)
+              { return a.name < b.name; });
+
+    ExpandedShader shader{version.empty() ? "" : version + "\n", 0, std::move(body.files)};
+    for (const ShaderDefine &define : used)
+        shader.text += std::format("#define {} {}\n", define.name, define.value);
+    shader.text += body.text;
+    shader.hash = hash64(shader.text);
+    return shader;
+}
+
+void ShaderPreprocessor::invalidate() noexcept
+{
+    m_files.clear();
+}
+
+ShaderVariantCache::ShaderVariantCache()
+    : m_stats{0, 0, 0}
+{
+}
+
+ShaderVariant ShaderVariantCache::get(std::string_view v_path, std::string_view f_path, std::span<const ShaderDefine> defines, const Build &build)
+{
+    m_stats.requests++;
+
+    // Request key, independent of the order the defines are given in
+    std::vector<ShaderDefine> sorted(defines.begin(), defines.end());
+    std::sort(sorted.begin(), sorted.end(), [](const ShaderDefine &a, const ShaderDefine &b)
+              { return a.name < b.name; });
+    uint64_t request = hash64(f_path, hash64_combine(f_path.size(), hash64(v_path, hash64_combine(v_path.size()))));
+    for (const ShaderDefine &define : sorted)
+    {
+        request = hash64(define.name, hash64_combine(define.name.size(), request));
+        request = hash64(define.value, hash64_combine(define.value.size(), request));
+    }
+    if (auto it = m_requests.find(request); it != m_requests.end())
+        return ShaderVariant{it->second};
+
+    // New combination, expand and look for a program with the same sources
+    m_stats.expansions++;
+    ExpandedShader v_shader = m_preprocessor.expand(v_path, sorted);
+    ExpandedShader f_shader = m_preprocessor.expand(f_path, sorted);
+    const uint64_t v_hashes[] = {v_shader.hash};
+    const uint64_t f_hashes[] = {f_shader.hash};
+    uint64_t source_hash = program_source_hash(v_hashes, f_hashes);
+
+    auto it = m_programs.find(source_hash);
+    if (it == m_programs.end())
+    {
+        const std::string_view v_sources[] = {v_shader.text};
+        const std::string_view f_sources[] = {f_shader.text};
+        it = m_programs.emplace(source_hash, build(v_sources, f_sources, source_hash)).first;
+        m_stats.programs++;
+    }
+    m_requests.emplace(request, it->second);
+    return ShaderVariant{it->second};
+}
+
+void ShaderVariantCache::clear() noexcept
+{
+    m_requests.clear();
+    m_programs.clear();
+    m_preprocessor.invalidate();
+}
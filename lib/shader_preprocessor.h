@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// One permutation switch, injected as `#define name value` after #version
+struct ShaderDefine
+{
+    std::string_view name;
+    std::string_view value = "1";
+};
+
+// A stage with every #include resolved and the defines it uses injected
+struct ExpandedShader
+{
+    std::string text;
+    uint64_t hash; // hash64 of text
+    // Source string numbers of the #line directives, compile errors read "<index>:<line>"
+    std::vector<std::string> files;
+};
+
+// Resolves `#include "path"` relative to the including file and honors `#pragma once`. Defines
+// no line of the expanded source mentions are dropped, so switches of another stage or
+// feature do not make an otherwise identical variant unique.
+class ShaderPreprocessor
+{
+private:
+    std::unordered_map<std::string, std::string> m_files; // Read once, until invalidate()
+
+    const std::string &file(const std::string &path);
+    void include(const std::string &path, ExpandedShader &out, std::vector<std::string> &stack, std::vector<std::string> &once, std::string &version);
+
+public:
+    [[nodiscard]] ExpandedShader expand(std::string_view path, std::span<const ShaderDefine> defines);
+
+    // Forget cached file contents, e.g. after a file changed on disk
+    void invalidate() noexcept;
+};
+
+// Program of one permutation, owned by the ShaderVariantCache that made it
+struct ShaderVariant
+{
+    unsigned int program;
+};
+
+struct ShaderVariantStats
+{
+    unsigned long requests;   // shader_variant calls
+    unsigned long expansions; // Requests seen for the first time, preprocessed
+    unsigned long programs;   // Unique expanded sources, each built once
+};
+
+// Maps (files, defines) to a program. Equal requests skip the preprocessor, requests that expand
+// to the same sources share one program.
+class ShaderVariantCache
+{
+public:
+    // Builds a program from expanded sources and their program_source_hash
+    using Build = std::function<unsigned int(std::span<const std::string_view>, std::span<const std::string_view>, uint64_t)>;
+
+private:
+    ShaderPreprocessor m_preprocessor;
+    std::unordered_map<uint64_t, unsigned int> m_requests; // Request hash to program
+    std::unordered_map<uint64_t, unsigned int> m_programs; // program_source_hash to program
+    ShaderVariantStats m_stats;
+
+public:
+    ShaderVariantCache();
+
+    [[nodiscard]] ShaderVariant get(std::string_view v_path, std::string_view f_path, std::span<const ShaderDefine> defines, const Build &build);
+
+    // Every program made so far, e.g. to delete them
+    [[nodiscard]] const std::unordered_map<uint64_t, unsigned int> &programs() const noexcept
+    {
+        return m_programs;
+    }
+
+    // Drops all variants and file contents, the caller deletes programs() first
+    void clear() noexcept;
+
+    [[nodiscard]] constexpr const ShaderVariantStats &stats() const noexcept
+    {
+        return m_stats;
+    }
+};
@@ -0,0 +1,192 @@
+#include <glad/glad.h>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "shader_reload.h"
+#include "app.h"
+#include "constant.h"
+#include "file.h"
+#include "trace.h"
+
+#ifdef __linux__
+static void add_watch(int inotify_fd, const std::string_view file)
+{
+    std::filesystem::path dir = std::filesystem::path(file).parent_path();
+    if (dir.empty())
+        dir = ".";
+
+    // Watching a directory twice returns the same descriptor
+    if (inotify_add_watch(inotify_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+        throw std::runtime_error("Failed to watch shader directory " + dir.string());
+}
+
+static void drain(int fd) noexcept
+{
+    alignas(inotify_event) char buf[4096];
+    while (read(fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+ShaderReloader::ShaderReloader(const Context &render_context, const std::string_view v_path, const std::string_view f_path)
+    : m_context(render_context.make_shared()),
+      m_v_path(v_path),
+      m_f_path(f_path),
+      m_inotify_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+      m_wake_fd(eventfd(0, EFD_CLOEXEC)),
+      m_ready_program(0),
+      m_ready_fence(nullptr)
+{
+    // The destructor does not run for a failed constructor, the descriptors are closed here
+    try
+    {
+        if (m_inotify_fd < 0 || m_wake_fd < 0)
+            throw std::runtime_error("Failed to initialize inotify");
+        add_watch(m_inotify_fd, m_v_path);
+        add_watch(m_inotify_fd, m_f_path);
+    }
+    catch (...)
+    {
+        if (m_inotify_fd >= 0)
+            close(m_inotify_fd);
+        if (m_wake_fd >= 0)
+            close(m_wake_fd);
+        throw;
+    }
+
+    m_thread = std::thread(&ShaderReloader::run, this);
+}
+
+ShaderReloader::~ShaderReloader()
+{
+    uint64_t one = 1;
+    if (write(m_wake_fd, &one, sizeof(one)) != sizeof(one))
+        perror("Failed to stop shader reloader");
+    if (m_thread.joinable())
+        m_thread.join();
+
+    if (m_ready_program)
+    {
+        glDeleteSync((GLsync)m_ready_fence);
+        glDeleteProgram(m_ready_program);
+    }
+    close(m_inotify_fd);
+    close(m_wake_fd);
+}
+
+void ShaderReloader::run() noexcept
+{
+    TRACE_THREAD_NAME("shader reload");
+    try
+    {
+        m_context.make_current();
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "Shader reloader disabled: %s\n", e.what());
+        return;
+    }
+
+    pollfd fds[2] = {{m_inotify_fd, POLLIN, 0}, {m_wake_fd, POLLIN, 0}};
+    while (true)
+    {
+        if (::poll(fds, 2, -1) < 0)
+            continue;
+        if (fds[1].revents)
+            break;
+        drain(m_inotify_fd);
+
+        // Editors save in bursts of events, wait until they settle
+        bool stop = false;
+        while (::poll(fds, 2, SHADER_RELOAD_DEBOUNCE_MS) > 0)
+        {
+            if ((stop = fds[1].revents))
+                break;
+            drain(m_inotify_fd);
+        }
+        if (stop)
+            break;
+
+        rebuild();
+    }
+
+    m_context.release();
+}
+#else
+ShaderReloader::ShaderReloader(const Context &render_context, const std::string_view v_path, const std::string_view f_path)
+    : m_inotify_fd(-1), m_wake_fd(-1), m_ready_program(0), m_ready_fence(nullptr)
+{
+    throw std::runtime_error("Shader hot reload needs inotify");
+}
+
+ShaderReloader::~ShaderReloader()
+{
+}
+
+void ShaderReloader::run() noexcept
+{
+}
+#endif
+
+void ShaderReloader::rebuild() noexcept
+{
+    TRACE_SCOPE("shader rebuild");
+    unsigned int program;
+    try
+    {
+        // Copies rather than mappings, editors may truncate the files in place while we read
+        const std::string v_shader = read_file(m_v_path);
+        const std::string_view v_shaders[] = {v_shader};
+        const std::string f_shader = read_file(m_f_path);
+        const std::string_view f_shaders[] = {f_shader};
+        program = make_program(v_shaders, f_shaders, nullptr);
+    }
+    catch (const std::exception &e)
+    {
+        // Keep rendering with the current program until the sources are fixed
+        fprintf(stderr, "Shader reload failed: %s\n", e.what());
+        return;
+    }
+
+    // The render context may only use the program once the driver is done with it
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+
+    std::lock_guard lock(m_mutex);
+    if (m_ready_program)
+    {
+        // Superseded before the render thread picked it up
+        glDeleteSync((GLsync)m_ready_fence);
+        glDeleteProgram(m_ready_program);
+    }
+    m_ready_program = program;
+    m_ready_fence = fence;
+    puts("Shaders reloaded");
+}
+
+unsigned int ShaderReloader::poll() noexcept
+{
+    // Never wait on the compile thread, try again next frame
+    std::unique_lock lock(m_mutex, std::try_to_lock);
+    if (!lock || !m_ready_program)
+        return 0;
+
+    if (glClientWaitSync((GLsync)m_ready_fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        return 0;
+
+    glDeleteSync((GLsync)m_ready_fence);
+    unsigned int program = m_ready_program;
+    m_ready_program = 0;
+    m_ready_fence = nullptr;
+    return program;
+}
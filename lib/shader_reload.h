@@ -0,0 +1,38 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "context.h"
+
+// Watches the shader directories with inotify and rebuilds the program on a background thread
+// owning a context shared with the render context. The render thread picks the result up
+// with poll() once its fence signaled, so it never waits on compilation.
+class ShaderReloader
+{
+private:
+    Context m_context;
+    std::string m_v_path;
+    std::string m_f_path;
+    int m_inotify_fd;
+    int m_wake_fd;
+    std::mutex m_mutex;
+    unsigned int m_ready_program;
+    void *m_ready_fence;
+    std::thread m_thread;
+
+    void run() noexcept;
+    void rebuild() noexcept;
+
+public:
+    // Must be called on the thread owning `render_context`, with it current
+    ShaderReloader(const Context &render_context, const std::string_view v_path, const std::string_view f_path);
+    ShaderReloader(const ShaderReloader &) = delete;
+    ShaderReloader &operator=(const ShaderReloader &) = delete;
+    ~ShaderReloader();
+
+    // Render thread, once per frame. Returns a linked program ready for use, 0 when there is none.
+    [[nodiscard]] unsigned int poll() noexcept;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+// Bounded ring between exactly one producer and one consumer thread, no locks. A full push or an
+// empty pop blocks on the other side's index with std::atomic::wait.
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    std::array<T, N> m_slots;
+    alignas(64) std::atomic<size_t> m_head; // Next slot to pop, written by the consumer
+    alignas(64) std::atomic<size_t> m_tail; // Next slot to push, written by the producer
+
+public:
+    SpscQueue() noexcept
+        : m_head(0), m_tail(0)
+    {
+    }
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer only
+    void push(T value)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head;
+        while (tail - (head = m_head.load(std::memory_order_acquire)) == N)
+            m_head.wait(head, std::memory_order_acquire);
+
+        m_slots[tail % N] = std::move(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_tail.notify_one();
+    }
+
+    // Consumer only
+    [[nodiscard]] T pop()
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail;
+        while ((tail = m_tail.load(std::memory_order_acquire)) == head)
+            m_tail.wait(tail, std::memory_order_acquire);
+
+        T value = std::move(m_slots[head % N]);
+        m_slots[head % N] = T();
+        m_head.store(head + 1, std::memory_order_release);
+        m_head.notify_one();
+        return value;
+    }
+};
@@ -0,0 +1,120 @@
+#include <glad/glad.h>
+#include <cstddef>
+#include <format>
+#include <stdexcept>
+
+#include "stream_buffer.h"
+#include "constant.h"
+#include "gl_ext.h"
+
+StreamBuffer::StreamBuffer(size_t segment_size)
+    : m_buffer(0),
+      m_segment_size((segment_size + STREAM_BUFFER_ALIGNMENT - 1) / STREAM_BUFFER_ALIGNMENT * STREAM_BUFFER_ALIGNMENT),
+      m_persistent(false),
+      m_mapped(nullptr),
+      m_map_start(0),
+      m_fences{},
+      m_segment(0),
+      m_used(0),
+      m_waited(false),
+      m_stats{0, 0}
+{
+    // The copy target leaves VAO and draw bindings alone
+    size_t size = m_segment_size * N_SEGMENTS;
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+
+    if (gl_ext_buffer_storage)
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        gl_ext_buffer_storage(GL_COPY_WRITE_BUFFER, size, NULL, flags);
+        m_mapped = (std::byte *)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+        m_persistent = m_mapped != nullptr;
+    }
+    else
+    {
+        glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STREAM_DRAW);
+    }
+
+    if (!m_persistent && gl_ext_buffer_storage)
+        throw std::runtime_error("Failed to map persistent stream buffer");
+}
+
+StreamBuffer::~StreamBuffer()
+{
+    if (m_mapped)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+    for (void *fence : m_fences)
+        if (fence)
+            glDeleteSync((GLsync)fence);
+    glDeleteBuffers(1, &m_buffer);
+}
+
+StreamAllocation StreamBuffer::allocate(size_t size, size_t alignment)
+{
+    // Aligned in the whole buffer, segments need not be multiples of odd alignments
+    size_t segment_base = m_segment * m_segment_size;
+    size_t offset = (segment_base + m_used + alignment - 1) / alignment * alignment - segment_base;
+    if (offset + size > m_segment_size)
+        throw std::runtime_error(std::format("Stream buffer segment of {} bytes exhausted", m_segment_size));
+
+    // Only now wait for the GPU to be done with the segment, frames without streaming never wait
+    if (!m_waited)
+    {
+        if (GLsync fence = (GLsync)m_fences[m_segment])
+        {
+            if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            {
+                m_stats.stalls++;
+                while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_BUFFER_WAIT_NS) == GL_TIMEOUT_EXPIRED)
+                    ;
+            }
+            glDeleteSync(fence);
+            m_fences[m_segment] = nullptr;
+        }
+        m_waited = true;
+    }
+
+    // The GPU is done with the segment and the range was never handed out, no need for implicit sync
+    if (!m_persistent && !m_mapped)
+    {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+        m_map_start = offset;
+        m_mapped = (std::byte *)glMapBufferRange(GL_COPY_WRITE_BUFFER, segment_base + offset, m_segment_size - offset, flags);
+        if (!m_mapped)
+            throw std::runtime_error("Failed to map stream buffer");
+    }
+
+    m_used = offset + size;
+    m_stats.bytes += size;
+    std::byte *data = m_persistent ? m_mapped + segment_base + offset : m_mapped + (offset - m_map_start);
+    return StreamAllocation{data, segment_base + offset};
+}
+
+void StreamBuffer::flush() noexcept
+{
+    // Coherent persistent writes are visible to the next GL command on their own
+    if (m_persistent || !m_mapped)
+        return;
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, m_used - m_map_start);
+    glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    m_mapped = nullptr;
+}
+
+void StreamBuffer::end_frame() noexcept
+{
+    if (m_used == 0)
+        return;
+
+    flush();
+    m_fences[m_segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_segment = (m_segment + 1) % N_SEGMENTS;
+    m_used = 0;
+    m_waited = false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+struct StreamAllocation
+{
+    std::byte *data; // CPU write pointer, valid until the next flush()
+    size_t offset;   // Offset of `data` in the GL buffer
+};
+
+struct StreamBufferStats
+{
+    unsigned long stalls; // Frames that had to wait for the GPU to release a segment
+    unsigned long bytes;  // Bytes handed out since creation
+};
+
+// Buffer split into per-frame segments (triple buffering) guarded by fences. The CPU writes
+// straight into GPU visible memory: a persistent coherent mapping with ARB_buffer_storage,
+// otherwise an unsynchronized, invalidating glMapBufferRange of the current segment.
+class StreamBuffer
+{
+private:
+    static constexpr int N_SEGMENTS = 3;
+
+    unsigned int m_buffer;
+    size_t m_segment_size;
+    bool m_persistent;
+    std::byte *m_mapped; // Whole buffer when persistent, [m_map_start, end of segment) otherwise
+    size_t m_map_start; // Offset in the segment of a non-persistent mapping
+    std::array<void *, N_SEGMENTS> m_fences;
+    int m_segment;
+    size_t m_used; // Bytes allocated in the current segment
+    bool m_waited; // The current segment's fence has been waited on
+    StreamBufferStats m_stats;
+
+public:
+    // Needs a current context with gl_ext_load done
+    explicit StreamBuffer(size_t segment_size);
+    StreamBuffer(const StreamBuffer &) = delete;
+    StreamBuffer &operator=(const StreamBuffer &) = delete;
+    ~StreamBuffer();
+
+    // Space in the current frame's segment, offset is a multiple of `alignment` (any positive value)
+    [[nodiscard]] StreamAllocation allocate(size_t size, size_t alignment);
+
+    // Make the writes visible to GL, call before drawing from the buffer
+    void flush() noexcept;
+
+    // Fence the segment after the last draw reading it and move on to the next one
+    void end_frame() noexcept;
+
+    [[nodiscard]] constexpr unsigned int id() const noexcept
+    {
+        return m_buffer;
+    }
+
+    [[nodiscard]] constexpr size_t segment_size() const noexcept
+    {
+        return m_segment_size;
+    }
+
+    [[nodiscard]] constexpr bool persistent() const noexcept
+    {
+        return m_persistent;
+    }
+
+    [[nodiscard]] constexpr const StreamBufferStats &stats() const noexcept
+    {
+        return m_stats;
+    }
+};
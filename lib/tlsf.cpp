@@ -0,0 +1,206 @@
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "tlsf.h"
+
+TlsfAllocator::TlsfAllocator(size_t capacity)
+    : m_fl_bitmap(0), m_last(NONE), m_capacity(0), m_used(0)
+{
+    m_sl_bitmap.fill(0);
+    for (auto &heads : m_heads)
+        heads.fill(NONE);
+    grow(capacity);
+}
+
+void TlsfAllocator::mapping(size_t size, int *fl, int *sl) noexcept
+{
+    // Sizes below SL_COUNT all share the first level, one class per size
+    if (size < (size_t)SL_COUNT)
+    {
+        *fl = 0;
+        *sl = (int)size;
+        return;
+    }
+    int msb = std::bit_width(size) - 1;
+    *fl = msb - SL_BITS + 1;
+    *sl = (int)((size >> (msb - SL_BITS)) ^ SL_COUNT);
+}
+
+uint32_t TlsfAllocator::new_block(size_t offset, size_t size) noexcept
+{
+    uint32_t block;
+    if (!m_unused.empty())
+    {
+        block = m_unused.back();
+        m_unused.pop_back();
+    }
+    else
+    {
+        block = m_blocks.size();
+        m_blocks.emplace_back();
+    }
+    m_blocks[block] = Block{offset, size, NONE, NONE, NONE, NONE, false};
+    return block;
+}
+
+void TlsfAllocator::insert_free(uint32_t block) noexcept
+{
+    int fl, sl;
+    mapping(m_blocks[block].size, &fl, &sl);
+
+    uint32_t head = m_heads[fl][sl];
+    m_blocks[block].free = true;
+    m_blocks[block].prev_free = NONE;
+    m_blocks[block].next_free = head;
+    if (head != NONE)
+        m_blocks[head].prev_free = block;
+    m_heads[fl][sl] = block;
+    m_fl_bitmap |= (uint64_t)1 << fl;
+    m_sl_bitmap[fl] |= 1u << sl;
+}
+
+void TlsfAllocator::remove_free(uint32_t block) noexcept
+{
+    int fl, sl;
+    mapping(m_blocks[block].size, &fl, &sl);
+
+    Block &b = m_blocks[block];
+    if (b.prev_free != NONE)
+        m_blocks[b.prev_free].next_free = b.next_free;
+    else
+        m_heads[fl][sl] = b.next_free;
+    if (b.next_free != NONE)
+        m_blocks[b.next_free].prev_free = b.prev_free;
+    b.free = false;
+
+    if (m_heads[fl][sl] == NONE)
+    {
+        m_sl_bitmap[fl] &= ~(1u << sl);
+        if (!m_sl_bitmap[fl])
+            m_fl_bitmap &= ~((uint64_t)1 << fl);
+    }
+}
+
+void TlsfAllocator::merge(uint32_t block, uint32_t next) noexcept
+{
+    m_blocks[block].size += m_blocks[next].size;
+    m_blocks[block].next_phys = m_blocks[next].next_phys;
+    if (m_blocks[next].next_phys != NONE)
+        m_blocks[m_blocks[next].next_phys].prev_phys = block;
+    if (m_last == next)
+        m_last = block;
+    m_unused.push_back(next);
+}
+
+uint32_t TlsfAllocator::allocate(size_t size) noexcept
+{
+    if (size == 0)
+        size = 1;
+
+    // Round up to the start of the next class, any block found there is large enough
+    size_t rounded = size;
+    if (size >= (size_t)SL_COUNT)
+    {
+        int msb = std::bit_width(size) - 1;
+        rounded += ((size_t)1 << (msb - SL_BITS)) - 1;
+        if (rounded < size)
+            return NONE;
+    }
+    int fl, sl;
+    mapping(rounded, &fl, &sl);
+    if (fl >= FL_COUNT)
+        return NONE;
+
+    // First non-empty class at or above (fl, sl)
+    uint32_t block = NONE;
+    uint32_t sl_map = m_sl_bitmap[fl] & (~0u << sl);
+    if (!sl_map)
+    {
+        uint64_t fl_map = fl + 1 < 64 ? m_fl_bitmap & (~(uint64_t)0 << (fl + 1)) : 0;
+        if (fl_map)
+        {
+            fl = std::countr_zero(fl_map);
+            sl_map = m_sl_bitmap[fl];
+        }
+    }
+    if (sl_map)
+        block = m_heads[fl][std::countr_zero(sl_map)];
+
+    // Nothing above, the head of the size's own class may still be large enough
+    if (block == NONE)
+    {
+        mapping(size, &fl, &sl);
+        block = m_heads[fl][sl];
+        if (block == NONE || m_blocks[block].size < size)
+            return NONE;
+    }
+    remove_free(block);
+
+    // Give the tail back as a new free block
+    if (m_blocks[block].size > size)
+    {
+        uint32_t rest = new_block(m_blocks[block].offset + size, m_blocks[block].size - size);
+        Block &b = m_blocks[block];
+        m_blocks[rest].prev_phys = block;
+        m_blocks[rest].next_phys = b.next_phys;
+        if (b.next_phys != NONE)
+            m_blocks[b.next_phys].prev_phys = rest;
+        b.next_phys = rest;
+        b.size = size;
+        if (m_last == block)
+            m_last = rest;
+        insert_free(rest);
+    }
+
+    m_used += m_blocks[block].size;
+    return block;
+}
+
+void TlsfAllocator::free(uint32_t block) noexcept
+{
+    if (block == NONE || m_blocks[block].free)
+        return;
+
+    m_used -= m_blocks[block].size;
+
+    // Coalesce with free physical neighbours so the range does not fragment over time
+    uint32_t next = m_blocks[block].next_phys;
+    if (next != NONE && m_blocks[next].free)
+    {
+        remove_free(next);
+        merge(block, next);
+    }
+    uint32_t prev = m_blocks[block].prev_phys;
+    if (prev != NONE && m_blocks[prev].free)
+    {
+        remove_free(prev);
+        merge(prev, block);
+        block = prev;
+    }
+    insert_free(block);
+}
+
+void TlsfAllocator::grow(size_t capacity) noexcept
+{
+    if (capacity <= m_capacity)
+        return;
+
+    size_t extra = capacity - m_capacity;
+    if (m_last != NONE && m_blocks[m_last].free)
+    {
+        remove_free(m_last);
+        m_blocks[m_last].size += extra;
+        insert_free(m_last);
+    }
+    else
+    {
+        uint32_t block = new_block(m_capacity, extra);
+        m_blocks[block].prev_phys = m_last;
+        if (m_last != NONE)
+            m_blocks[m_last].next_phys = block;
+        m_last = block;
+        insert_free(block);
+    }
+    m_capacity = capacity;
+}
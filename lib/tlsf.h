@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Two-level segregated fit allocator over an abstract range [0, capacity), e.g. the vertices of a GL
+// buffer. Allocation and free are O(1): a first level per power of two, split linearly into
+// TLSF_SL_COUNT second level classes, with a bitmap per level to find the first non-empty free list.
+// Freed blocks are merged with their free physical neighbours.
+class TlsfAllocator
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+private:
+    static constexpr int SL_BITS = 4;
+    static constexpr int SL_COUNT = 1 << SL_BITS;
+    static constexpr int FL_COUNT = 64 - SL_BITS + 1;
+
+    struct Block
+    {
+        size_t offset;
+        size_t size;
+        uint32_t prev_phys; // Neighbours in address order
+        uint32_t next_phys;
+        uint32_t prev_free; // Neighbours in the free list of the block's class
+        uint32_t next_free;
+        bool free;
+    };
+
+    std::vector<Block> m_blocks;
+    std::vector<uint32_t> m_unused; // Recycled m_blocks slots
+    uint64_t m_fl_bitmap;
+    std::array<uint32_t, FL_COUNT> m_sl_bitmap;
+    std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> m_heads;
+    uint32_t m_last; // Block ending at m_capacity
+    size_t m_capacity;
+    size_t m_used;
+
+    // Size class of a free block
+    static void mapping(size_t size, int *fl, int *sl) noexcept;
+    [[nodiscard]] uint32_t new_block(size_t offset, size_t size) noexcept;
+    void insert_free(uint32_t block) noexcept;
+    void remove_free(uint32_t block) noexcept;
+    // Absorb `next`, its physical successor, into `block`
+    void merge(uint32_t block, uint32_t next) noexcept;
+
+public:
+    explicit TlsfAllocator(size_t capacity);
+
+    // Block id, NONE when no free block is large enough
+    [[nodiscard]] uint32_t allocate(size_t size) noexcept;
+    void free(uint32_t block) noexcept;
+
+    // Extend the range, the new space joins the last block when it is free
+    void grow(size_t capacity) noexcept;
+
+    [[nodiscard]] size_t offset(uint32_t block) const noexcept
+    {
+        return m_blocks[block].offset;
+    }
+
+    [[nodiscard]] size_t size(uint32_t block) const noexcept
+    {
+        return m_blocks[block].size;
+    }
+
+    [[nodiscard]] constexpr size_t capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+    [[nodiscard]] constexpr size_t used() const noexcept
+    {
+        return m_used;
+    }
+};
@@ -0,0 +1,146 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "trace.h"
+#include "constant.h"
+
+struct TraceEvent
+{
+    const char *name;
+    uint64_t begin_ns;
+    uint64_t end_ns;
+};
+
+// Written by its thread only, `size` publishes the events before it to trace_write
+struct TraceBuffer
+{
+    std::unique_ptr<TraceEvent[]> events;
+    std::atomic<size_t> size;
+    std::atomic<const char *> thread_name;
+    std::atomic<unsigned long> dropped;
+    unsigned int tid;
+};
+
+static const std::chrono::steady_clock::time_point g_trace_epoch = std::chrono::steady_clock::now();
+
+// Buffers outlive their threads, so spans of finished threads still get written
+static std::mutex g_trace_mutex;
+static std::vector<std::unique_ptr<TraceBuffer>> g_trace_buffers;
+static thread_local TraceBuffer *t_trace_buffer = nullptr;
+
+// The lock is only taken the first time a thread records
+static TraceBuffer &thread_buffer()
+{
+    if (!t_trace_buffer)
+    {
+        auto buffer = std::make_unique<TraceBuffer>();
+        buffer->events = std::make_unique<TraceEvent[]>(TRACE_BUFFER_EVENTS);
+        buffer->size = 0;
+        buffer->thread_name = nullptr;
+        buffer->dropped = 0;
+
+        std::lock_guard lock(g_trace_mutex);
+        buffer->tid = g_trace_buffers.size() + 1;
+        t_trace_buffer = buffer.get();
+        g_trace_buffers.push_back(std::move(buffer));
+    }
+    return *t_trace_buffer;
+}
+
+// Literals only, anything else is replaced rather than escaped
+static std::string json_name(const char *name)
+{
+    std::string retval;
+    for (const char *c = name; *c; c++)
+        retval += (*c == '"' || *c == '\\' || (unsigned char)*c < 0x20) ? '_' : *c;
+    return retval;
+}
+
+uint64_t trace_now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - g_trace_epoch).count();
+}
+
+void trace_span(const char *name, uint64_t begin_ns, uint64_t end_ns) noexcept
+{
+    TraceBuffer *buffer;
+    try
+    {
+        buffer = &thread_buffer();
+    }
+    catch (...)
+    {
+        return;
+    }
+
+    size_t n = buffer->size.load(std::memory_order_relaxed);
+    if (n == TRACE_BUFFER_EVENTS)
+    {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events[n] = TraceEvent{name, begin_ns, end_ns};
+    buffer->size.store(n + 1, std::memory_order_release);
+}
+
+void trace_thread_name(const char *name) noexcept
+{
+    try
+    {
+        thread_buffer().thread_name.store(name, std::memory_order_release);
+    }
+    catch (...)
+    {
+    }
+}
+
+void trace_write(const std::string_view path)
+{
+    FILE *file = fopen(std::string(path).c_str(), "w");
+    if (!file)
+        throw std::runtime_error(std::format("Failed to open {}", path));
+
+    // Complete events, microseconds
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"%s\"}}", WIN_TITLE);
+    std::lock_guard lock(g_trace_mutex);
+    for (const auto &buffer : g_trace_buffers)
+    {
+        if (const char *name = buffer->thread_name.load(std::memory_order_acquire))
+            fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %u, \"args\": {\"name\": \"%s\"}}", buffer->tid, json_name(name).c_str());
+
+        size_t n = buffer->size.load(std::memory_order_acquire);
+        for (size_t i = 0; i < n; i++)
+        {
+            const TraceEvent &event = buffer->events[i];
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}",
+                    json_name(event.name).c_str(), buffer->tid, event.begin_ns / 1e3, (event.end_ns - event.begin_ns) / 1e3);
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    bool failed = ferror(file);
+    if (fclose(file) != 0 || failed)
+        throw std::runtime_error(std::format("Failed to write {}", path));
+}
+
+TraceStats trace_stats() noexcept
+{
+    TraceStats stats{0, 0};
+    std::lock_guard lock(g_trace_mutex);
+    for (const auto &buffer : g_trace_buffers)
+    {
+        stats.spans += buffer->size.load(std::memory_order_acquire);
+        stats.dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
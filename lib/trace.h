@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Spans are recorded unless NDEBUG is defined, -DAPP_TRACE=0 or 1 overrides
+#ifndef APP_TRACE
+#ifdef NDEBUG
+#define APP_TRACE 0
+#else
+#define APP_TRACE 1
+#endif
+#endif
+
+struct TraceStats
+{
+    unsigned long spans;   // Recorded, over all threads
+    unsigned long dropped; // Lost to full thread buffers
+};
+
+// Nanoseconds since process start
+[[nodiscard]] uint64_t trace_now() noexcept;
+
+// Appends to the calling thread's buffer without locking. `name` is kept as a pointer, pass literals.
+void trace_span(const char *name, uint64_t begin_ns, uint64_t end_ns) noexcept;
+void trace_thread_name(const char *name) noexcept;
+
+// Every span recorded so far as Chrome trace event JSON, opens in chrome://tracing and Perfetto.
+// Threads may keep recording meanwhile, their newer spans are left out.
+void trace_write(const std::string_view path);
+[[nodiscard]] TraceStats trace_stats() noexcept;
+
+// Span from construction to destruction
+class TraceScope
+{
+private:
+    const char *m_name;
+    uint64_t m_begin;
+
+public:
+    explicit TraceScope(const char *name) noexcept
+        : m_name(name), m_begin(trace_now())
+    {
+    }
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+
+    ~TraceScope()
+    {
+        trace_span(m_name, m_begin, trace_now());
+    }
+};
+
+// Back to back spans on one thread, each next() ends the running span, e.g. for frame phases
+class TraceTimeline
+{
+private:
+    const char *m_name = nullptr;
+    uint64_t m_begin = 0;
+
+public:
+    void next(const char *name) noexcept
+    {
+        uint64_t now = trace_now();
+        if (m_name)
+            trace_span(m_name, m_begin, now);
+        m_name = name;
+        m_begin = now;
+    }
+
+    void end() noexcept
+    {
+        if (m_name)
+            trace_span(m_name, m_begin, trace_now());
+        m_name = nullptr;
+    }
+};
+
+#if APP_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_THREAD_NAME(name) trace_thread_name(name)
+#define TRACE_NEXT(timeline, name) (timeline).next(name)
+#define TRACE_END(timeline) (timeline).end()
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#define TRACE_NEXT(timeline, name) ((void)0)
+#define TRACE_END(timeline) ((void)0)
+#endif
@@ -0,0 +1,72 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <format>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "uniform.h"
+#include "constant.h"
+
+void UniformTable::reflect(unsigned int program)
+{
+    m_uniforms.clear();
+
+    int n_uniforms = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &n_uniforms);
+    m_uniforms.reserve(n_uniforms);
+
+    char name[GL_UNIFORM_NAME_BUF_LEN];
+    for (int i = 0; i < n_uniforms; i++)
+    {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, sizeof(name), &length, &size, &type, name);
+
+        // Block members have no location, they are fed through buffers
+        int location = glGetUniformLocation(program, name);
+        if (location < 0)
+            continue;
+
+        std::string_view key(name, length);
+        m_uniforms.push_back(UniformInfo{hash_name(key), location, type, size});
+
+        // Arrays are reported as "name[0]", make the bare name resolve too
+        if (key.ends_with("[0]"))
+            m_uniforms.push_back(UniformInfo{hash_name(key.substr(0, key.size() - 3)), location, type, size});
+    }
+
+    std::sort(m_uniforms.begin(), m_uniforms.end(), [](const UniformInfo &a, const UniformInfo &b)
+              { return a.hash < b.hash; });
+    auto duplicate = std::adjacent_find(m_uniforms.begin(), m_uniforms.end(), [](const UniformInfo &a, const UniformInfo &b)
+                                        { return a.hash == b.hash; });
+    if (duplicate != m_uniforms.end())
+        throw std::runtime_error(std::format("Uniform name hash collision ({:x})", duplicate->hash));
+}
+
+void UniformTable::clear() noexcept
+{
+    m_uniforms.clear();
+}
+
+const UniformInfo *UniformTable::find(uint32_t hash) const noexcept
+{
+    auto it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), hash, [](const UniformInfo &info, uint32_t hash)
+                               { return info.hash < hash; });
+    if (it == m_uniforms.end() || it->hash != hash)
+        return nullptr;
+    return &*it;
+}
+
+int UniformTable::location(std::string_view name) const noexcept
+{
+    const UniformInfo *info = find(hash_name(name));
+    return info ? info->location : -1;
+}
+
+int UniformTable::location(UniformKey key) const noexcept
+{
+    const UniformInfo *info = find(key.hash);
+    return info ? info->location : -1;
+}
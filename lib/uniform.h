@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// FNV-1a, uniform names are hashed once at setup or at compile time
+[[nodiscard]] constexpr uint32_t hash_name(std::string_view name) noexcept
+{
+    uint32_t hash = 2166136261u;
+    for (char c : name)
+    {
+        hash ^= (unsigned char)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Uniform name hashed at compile time, e.g. app.uniform_location(UniformKey("posOffset"))
+struct UniformKey
+{
+    uint32_t hash;
+
+    explicit consteval UniformKey(const char *name) noexcept
+        : hash(hash_name(name))
+    {
+    }
+};
+
+struct UniformInfo
+{
+    uint32_t hash;
+    int location;
+    unsigned int type;
+    int size;
+};
+
+// Active uniforms of a linked program, enumerated once with glGetActiveUniform
+class UniformTable
+{
+private:
+    std::vector<UniformInfo> m_uniforms; // Sorted by hash
+
+    [[nodiscard]] const UniformInfo *find(uint32_t hash) const noexcept;
+
+public:
+    void reflect(unsigned int program);
+    void clear() noexcept;
+
+    // -1 when the uniform is not active, like glGetUniformLocation
+    [[nodiscard]] int location(std::string_view name) const noexcept;
+    [[nodiscard]] int location(UniformKey key) const noexcept;
+
+    [[nodiscard]] const std::vector<UniformInfo> &uniforms() const noexcept
+    {
+        return m_uniforms;
+    }
+};
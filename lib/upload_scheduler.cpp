@@ -0,0 +1,128 @@
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <span>
+#include <vector>
+
+#include "upload_scheduler.h"
+#include "constant.h"
+
+UploadScheduler::UploadScheduler(size_t budget, double frame_target) noexcept
+    : m_max_budget(budget),
+      m_frame_target(frame_target),
+      m_budget(budget),
+      m_last_bytes(0),
+      m_next_order(0)
+{
+}
+
+void UploadScheduler::configure(size_t budget, double frame_target) noexcept
+{
+    m_max_budget = m_budget = budget;
+    m_frame_target = frame_target;
+}
+
+bool UploadScheduler::done(const Request &request) noexcept
+{
+    return request.vertices_done == request.vertices.size() && request.elements_done == request.elements.size() * sizeof(unsigned int);
+}
+
+size_t UploadScheduler::find(MeshHandle mesh) const noexcept
+{
+    for (size_t i = 0; i < m_requests.size(); i++)
+        if (m_requests[i].mesh == mesh)
+            return i;
+    return SIZE_MAX;
+}
+
+void UploadScheduler::add(MeshHandle mesh, const std::span<const std::byte> vertices, const std::span<const unsigned int> elements, float priority)
+{
+    m_requests.push_back(Request{mesh, priority, m_next_order++, std::vector<std::byte>(vertices.begin(), vertices.end()),
+                                 std::vector<unsigned int>(elements.begin(), elements.end()), 0, 0});
+}
+
+bool UploadScheduler::set_priority(MeshHandle mesh, float priority) noexcept
+{
+    size_t index = find(mesh);
+    if (index == SIZE_MAX)
+        return false;
+
+    m_requests[index].priority = priority;
+    return true;
+}
+
+void UploadScheduler::cancel(MeshHandle mesh) noexcept
+{
+    size_t index = find(mesh);
+    if (index != SIZE_MAX)
+        m_requests.erase(m_requests.begin() + index);
+}
+
+void UploadScheduler::schedule(double last_frame_seconds, std::vector<UploadChunk> &chunks, std::vector<std::byte> &staging)
+{
+    // Back off quickly, recover slowly, so a slow frame is not followed by another one. The slack
+    // keeps frames paced by vsync from counting as over.
+    if (m_frame_target > 0. && last_frame_seconds > 0.)
+    {
+        if (last_frame_seconds > m_frame_target * 1.1)
+            m_budget = std::max(m_budget / 2, std::min(UPLOAD_MIN_BUDGET_BYTES, m_max_budget));
+        else
+            m_budget = std::min(m_budget + m_budget / 4, m_max_budget);
+    }
+
+    m_last_bytes = 0;
+    if (m_requests.empty())
+        return;
+
+    m_order.resize(m_requests.size());
+    std::iota(m_order.begin(), m_order.end(), 0);
+    std::sort(m_order.begin(), m_order.end(), [&](uint32_t a, uint32_t b)
+              { return m_requests[a].priority < m_requests[b].priority ||
+                       (m_requests[a].priority == m_requests[b].priority && m_requests[a].order < m_requests[b].order); });
+
+    // Whole units only, a chunk of elements stays aligned in the staging for the copy
+    size_t left = m_budget;
+    size_t last_chunk; // This request's newest chunk, SIZE_MAX while it has none
+    auto take = [&](const Request &request, const std::byte *data, size_t size, size_t &taken, bool elements, size_t unit)
+    {
+        size_t n = std::min(left, size - taken) / unit * unit;
+        if (n == 0)
+            return;
+        staging.resize((staging.size() + unit - 1) / unit * unit);
+        last_chunk = chunks.size();
+        chunks.push_back(UploadChunk{request.mesh, elements, taken, n, staging.size(), false});
+        staging.insert(staging.end(), data + taken, data + taken + n);
+        taken += n;
+        left -= n;
+    };
+    // Every request is visited, even once the budget is spent: done ones are dropped below and must
+    // have had their last chunk
+    for (uint32_t index : m_order)
+    {
+        Request &request = m_requests[index];
+        last_chunk = SIZE_MAX;
+        take(request, request.vertices.data(), request.vertices.size(), request.vertices_done, false, 1);
+        take(request, (const std::byte *)request.elements.data(), request.elements.size() * sizeof(unsigned int), request.elements_done, true, sizeof(unsigned int));
+        if (done(request))
+        {
+            // Nothing to copy still completes the mesh, through an empty chunk
+            if (last_chunk == SIZE_MAX)
+            {
+                last_chunk = chunks.size();
+                chunks.push_back(UploadChunk{request.mesh, false, 0, 0, staging.size(), false});
+            }
+            chunks[last_chunk].last = true;
+        }
+    }
+    m_last_bytes = m_budget - left;
+
+    std::erase_if(m_requests, done);
+}
+
+UploadSchedulerStats UploadScheduler::stats() const noexcept
+{
+    size_t bytes = 0;
+    for (const Request &request : m_requests)
+        bytes += request.vertices.size() - request.vertices_done + request.elements.size() * sizeof(unsigned int) - request.elements_done;
+    return UploadSchedulerStats{m_requests.size(), bytes, m_budget, m_last_bytes};
+}
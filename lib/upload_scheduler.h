@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "mesh.h"
+
+// A piece of a streamed mesh to write this frame
+struct UploadChunk
+{
+    MeshHandle mesh;
+    bool elements; // Into the mesh's elements, else its vertices
+    size_t offset; // Bytes into the mesh's vertices or elements
+    size_t size;
+    size_t data; // Bytes into the frame's staging
+    bool last;   // The mesh is complete once this is written
+};
+
+struct UploadSchedulerStats
+{
+    size_t pending_meshes;
+    size_t pending_bytes;
+    size_t budget;     // Bytes allowed next frame
+    size_t last_bytes; // Bytes scheduled last frame
+};
+
+// Meshes streamed into the registry over several frames. Every frame schedule() hands out chunks of
+// the pending meshes, lowest priority value first, until the frame's byte budget is spent. With a
+// frame target the budget adapts to the measured frame time: halved when a frame ran over, grown
+// back a quarter at a time up to the configured budget while frames keep to it.
+class UploadScheduler
+{
+private:
+    struct Request
+    {
+        MeshHandle mesh;
+        float priority;
+        uint64_t order; // Ties go first come, first served
+        std::vector<std::byte> vertices;
+        std::vector<unsigned int> elements;
+        size_t vertices_done; // Bytes scheduled
+        size_t elements_done;
+    };
+
+    std::vector<Request> m_requests;
+    std::vector<uint32_t> m_order; // Request indices, sorted by schedule()
+    size_t m_max_budget;
+    double m_frame_target;
+    size_t m_budget;
+    size_t m_last_bytes;
+    uint64_t m_next_order;
+
+    [[nodiscard]] static bool done(const Request &request) noexcept;
+    [[nodiscard]] size_t find(MeshHandle mesh) const noexcept;
+
+public:
+    // `frame_target` in seconds, 0 keeps the budget fixed
+    UploadScheduler(size_t budget, double frame_target) noexcept;
+
+    void configure(size_t budget, double frame_target) noexcept;
+
+    // The mesh was reserved in the registry, its data is copied
+    void add(MeshHandle mesh, const std::span<const std::byte> vertices, const std::span<const unsigned int> elements, float priority);
+    // False when the mesh is not pending
+    bool set_priority(MeshHandle mesh, float priority) noexcept;
+    // Drop what is left of the mesh, e.g. it was destroyed
+    void cancel(MeshHandle mesh) noexcept;
+    // This frame's chunks appended to `chunks`, their bytes to `staging`. The scheduler is done with
+    // a mesh after its last chunk.
+    void schedule(double last_frame_seconds, std::vector<UploadChunk> &chunks, std::vector<std::byte> &staging);
+
+    [[nodiscard]] UploadSchedulerStats stats() const noexcept;
+};
@@ -0,0 +1,159 @@
+#include <glad/glad.h>
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "upload_service.h"
+#include "constant.h"
+#include "trace.h"
+
+UploadService::UploadService(const Context &render_context)
+    : m_context(render_context.make_shared()),
+      m_next_ticket(1),
+      m_started(false),
+      m_stop(false),
+      m_stats{0, 0, 0}
+{
+    m_thread = std::thread(&UploadService::run, this);
+
+    // Like RenderThread, a context the thread cannot use is the caller's error, not a service that
+    // silently never uploads
+    std::unique_lock lock(m_mutex);
+    m_cv.wait(lock, [&]
+              { return m_started; });
+    if (m_start_error)
+    {
+        lock.unlock();
+        m_thread.join();
+        std::rethrow_exception(m_start_error);
+    }
+}
+
+UploadService::~UploadService()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+
+    for (const Ready &ready : m_ready)
+    {
+        glDeleteSync((GLsync)ready.fence);
+        glDeleteBuffers(1, &ready.buffers.vertex_buffer);
+        glDeleteBuffers(1, &ready.buffers.element_buffer);
+    }
+}
+
+uint64_t UploadService::submit(const std::span<const std::byte> vertices, const std::span<const unsigned int> elements)
+{
+    Request request{0, std::vector<std::byte>(vertices.begin(), vertices.end()), std::vector<unsigned int>(elements.begin(), elements.end())};
+    uint64_t ticket;
+    {
+        std::lock_guard lock(m_mutex);
+        ticket = request.ticket = m_next_ticket++;
+        m_requests.push_back(std::move(request));
+        m_stats.requests++;
+    }
+    m_cv.notify_one();
+    return ticket;
+}
+
+void UploadService::run() noexcept
+{
+    TRACE_THREAD_NAME("upload");
+    std::exception_ptr error;
+    try
+    {
+        m_context.make_current();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+    {
+        std::lock_guard lock(m_mutex);
+        m_started = true;
+        m_start_error = error;
+    }
+    m_cv.notify_all();
+    if (error)
+        return;
+
+    while (true)
+    {
+        Request request;
+        {
+            std::unique_lock lock(m_mutex);
+            m_cv.wait(lock, [&]
+                      { return m_stop || !m_requests.empty(); });
+            if (m_stop)
+                break;
+            request = std::move(m_requests.front());
+            m_requests.pop_front();
+        }
+
+        Ready ready;
+        {
+            TRACE_SCOPE("upload buffers");
+            ready.buffers = Buffers{request.ticket, upload(request.vertices.data(), request.vertices.size()),
+                                    upload(request.elements.data(), request.elements.size() * sizeof(unsigned int)), request.elements.size()};
+
+            // The render context may only draw from the buffers once the copies are done
+            ready.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            glFlush();
+        }
+
+        std::lock_guard lock(m_mutex);
+        m_ready.push_back(ready);
+        m_stats.uploaded++;
+        m_stats.bytes += request.vertices.size() + request.elements.size() * sizeof(unsigned int);
+    }
+
+    m_context.release();
+}
+
+unsigned int UploadService::upload(const void *data, size_t size) noexcept
+{
+    // Copy write target, the buffer gets bound to its real targets in the render context's VAO
+    unsigned int buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_STATIC_DRAW);
+
+    // In slices, the driver can start copying the first ones while the rest is submitted
+    for (size_t offset = 0; offset < size; offset += UPLOAD_SLICE_BYTES)
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, std::min(UPLOAD_SLICE_BYTES, size - offset), (const std::byte *)data + offset);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    return buffer;
+}
+
+bool UploadService::poll(Buffers &buffers) noexcept
+{
+    // Never wait on the upload thread, try again next frame
+    std::unique_lock lock(m_mutex, std::try_to_lock);
+    if (!lock || m_ready.empty())
+        return false;
+
+    // A failed wait says nothing about the copies, only a signaled fence hands the buffers over
+    Ready &ready = m_ready.front();
+    GLenum status = glClientWaitSync((GLsync)ready.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+        return false;
+
+    glDeleteSync((GLsync)ready.fence);
+    buffers = ready.buffers;
+    m_ready.pop_front();
+    return true;
+}
+
+UploadStats UploadService::stats() noexcept
+{
+    std::lock_guard lock(m_mutex);
+    return m_stats;
+}
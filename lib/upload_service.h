@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "context.h"
+
+struct UploadStats
+{
+    unsigned long requests;
+    unsigned long uploaded; // Buffers fenced and handed over
+    size_t bytes;
+};
+
+// Vertex and element buffers uploaded on a background thread owning a context shared with the
+// render context, so a large mesh never stalls a frame. Like ShaderReloader, finished buffers are
+// picked up by the render thread with poll() once their fence signaled. VAOs are not shared
+// between contexts, the render thread builds its own around the buffers.
+class UploadService
+{
+public:
+    struct Buffers
+    {
+        uint64_t ticket;
+        unsigned int vertex_buffer;
+        unsigned int element_buffer;
+        size_t n_elements;
+    };
+
+private:
+    struct Request
+    {
+        uint64_t ticket;
+        std::vector<std::byte> vertices;
+        std::vector<unsigned int> elements;
+    };
+
+    struct Ready
+    {
+        Buffers buffers;
+        void *fence;
+    };
+
+    Context m_context;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Request> m_requests;
+    std::deque<Ready> m_ready;
+    uint64_t m_next_ticket;
+    bool m_started; // The thread set up its context, or failed to with m_start_error
+    std::exception_ptr m_start_error;
+    bool m_stop;
+    UploadStats m_stats;
+    std::thread m_thread;
+
+    void run() noexcept;
+    [[nodiscard]] unsigned int upload(const void *data, size_t size) noexcept;
+
+public:
+    // Must be called on the thread owning `render_context`, with it current. Waits for the upload
+    // thread's context and throws when it cannot be made current there.
+    explicit UploadService(const Context &render_context);
+    UploadService(const UploadService &) = delete;
+    UploadService &operator=(const UploadService &) = delete;
+    // Drops the requests not uploaded yet, deletes the buffers never picked up
+    ~UploadService();
+
+    // Any thread, the data is copied. Tickets start at 1 and grow in submission order.
+    [[nodiscard]] uint64_t submit(const std::span<const std::byte> vertices, const std::span<const unsigned int> elements);
+
+    // Render thread. The oldest finished buffers, in submission order; the caller owns them.
+    // Never waits on the upload thread, false when nothing is ready.
+    [[nodiscard]] bool poll(Buffers &buffers) noexcept;
+
+    [[nodiscard]] UploadStats stats() noexcept;
+};
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cstddef>
+#include <span>
+
+#include "vec_math.h"
+
+#ifdef __AVX__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__) || defined(__SSE2__)
+// The same kernels for 4 and 8 lanes: AVX shuffles work within 128-bit halves, so a 256-bit
+// register holds two independent groups of 4 and every SSE shuffle carries over unchanged
+
+// (a[i0], a[i1], b[i2], b[i3])
+template <int i0, int i1, int i2, int i3>
+static inline __m128 pick(__m128 a, __m128 b) noexcept
+{
+    return _mm_shuffle_ps(a, b, _MM_SHUFFLE(i3, i2, i1, i0));
+}
+
+static inline __m128 splat(float s, __m128) noexcept
+{
+    return _mm_set1_ps(s);
+}
+
+static inline __m128 mul(__m128 a, __m128 b) noexcept
+{
+    return _mm_mul_ps(a, b);
+}
+
+static inline __m128 add(__m128 a, __m128 b) noexcept
+{
+    return _mm_add_ps(a, b);
+}
+
+static inline __m128 mul_add(__m128 a, __m128 b, __m128 c) noexcept
+{
+#ifdef __FMA__
+    return _mm_fmadd_ps(a, b, c);
+#else
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+}
+
+#ifdef __AVX__
+template <int i0, int i1, int i2, int i3>
+static inline __m256 pick(__m256 a, __m256 b) noexcept
+{
+    return _mm256_shuffle_ps(a, b, _MM_SHUFFLE(i3, i2, i1, i0));
+}
+
+static inline __m256 splat(float s, __m256) noexcept
+{
+    return _mm256_set1_ps(s);
+}
+
+static inline __m256 mul(__m256 a, __m256 b) noexcept
+{
+    return _mm256_mul_ps(a, b);
+}
+
+static inline __m256 add(__m256 a, __m256 b) noexcept
+{
+    return _mm256_add_ps(a, b);
+}
+
+static inline __m256 mul_add(__m256 a, __m256 b, __m256 c) noexcept
+{
+#ifdef __FMA__
+    return _mm256_fmadd_ps(a, b, c);
+#else
+    return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+}
+#endif
+
+// The affine part of a matrix broadcast per register, s[row][col]. Splatted once per call: the
+// output could alias the matrix as far as the compiler knows, it would reload them every block.
+template <typename V>
+static inline void splat_affine(const Mat4f &m, V (&s)[3][4]) noexcept
+{
+    for (int row = 0; row < 3; row++)
+        for (int col = 0; col < 4; col++)
+            s[row][col] = splat((&m.columns[col].x)[row], V{});
+}
+
+// Four points packed as x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3 in (a, b, c), per group of lanes.
+// Transposed to x, y and z registers, transformed, and packed back in place.
+template <typename V>
+static inline void transform_packed(const V (&s)[3][4], V &a, V &b, V &c) noexcept
+{
+    V x = pick<0, 3, 0, 2>(a, pick<2, 2, 1, 1>(b, c));
+    V y = pick<0, 2, 0, 2>(pick<1, 1, 0, 0>(a, b), pick<3, 3, 2, 2>(b, c));
+    V z = pick<0, 2, 0, 2>(pick<2, 2, 1, 1>(a, b), pick<0, 0, 3, 3>(c, c));
+
+    // Summed in the order of the scalar product, the results only differ where FMA fuses
+    V r[3];
+    for (int row = 0; row < 3; row++)
+        r[row] = add(mul_add(z, s[row][2], mul_add(y, s[row][1], mul(x, s[row][0]))), s[row][3]);
+
+    a = pick<0, 2, 0, 2>(pick<0, 0, 0, 0>(r[0], r[1]), pick<0, 0, 1, 1>(r[2], r[0]));
+    b = pick<0, 2, 0, 2>(pick<1, 1, 1, 1>(r[1], r[2]), pick<2, 2, 2, 2>(r[0], r[1]));
+    c = pick<0, 2, 0, 2>(pick<2, 2, 3, 3>(r[2], r[0]), pick<3, 3, 3, 3>(r[1], r[2]));
+}
+#endif
+
+void transform_points(const Mat4f &m, const std::span<const Vec3f> points, const std::span<Vec3f> out) noexcept
+{
+    size_t n = std::min(points.size(), out.size()), i = 0;
+
+#if defined(__AVX__) || defined(__SSE2__)
+    // Cast rather than &data()->x, an empty span may hold a null pointer
+    const float *src = (const float *)points.data();
+    float *dst = (float *)out.data();
+#endif
+#ifdef __AVX__
+    // Points 0-3 in the low halves, 4-7 in the high ones
+    __m256 wide[3][4];
+    splat_affine(m, wide);
+    for (; i + 8 <= n; i += 8)
+    {
+        const float *p = src + i * 3;
+        __m256 a = _mm256_loadu2_m128(p + 12, p);
+        __m256 b = _mm256_loadu2_m128(p + 16, p + 4);
+        __m256 c = _mm256_loadu2_m128(p + 20, p + 8);
+        transform_packed(wide, a, b, c);
+        float *q = dst + i * 3;
+        _mm256_storeu2_m128(q + 12, q, a);
+        _mm256_storeu2_m128(q + 16, q + 4, b);
+        _mm256_storeu2_m128(q + 20, q + 8, c);
+    }
+#endif
+#if defined(__AVX__) || defined(__SSE2__)
+    __m128 narrow[3][4];
+    splat_affine(m, narrow);
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128 a = _mm_loadu_ps(src + i * 3);
+        __m128 b = _mm_loadu_ps(src + i * 3 + 4);
+        __m128 c = _mm_loadu_ps(src + i * 3 + 8);
+        transform_packed(narrow, a, b, c);
+        _mm_storeu_ps(dst + i * 3, a);
+        _mm_storeu_ps(dst + i * 3 + 4, b);
+        _mm_storeu_ps(dst + i * 3 + 8, c);
+    }
+#endif
+    for (; i < n; i++)
+        out[i] = transform_point(m, points[i]);
+}
+
+void multiply_matrices(const std::span<const Mat4f> a, const std::span<const Mat4f> b, const std::span<Mat4f> out) noexcept
+{
+    size_t n = std::min({a.size(), b.size(), out.size()});
+    for (size_t i = 0; i < n; i++)
+    {
+#if defined(__AVX__) || defined(__SSE2__)
+        const float *pa = a[i].data(), *pb = b[i].data();
+#endif
+#ifdef __AVX__
+        // Two result columns per register, each half broadcasts its column's components
+        __m256 a0 = _mm256_broadcast_ps((const __m128 *)pa), a1 = _mm256_broadcast_ps((const __m128 *)(pa + 4));
+        __m256 a2 = _mm256_broadcast_ps((const __m128 *)(pa + 8)), a3 = _mm256_broadcast_ps((const __m128 *)(pa + 12));
+        __m256 r[2];
+        for (int j = 0; j < 2; j++)
+        {
+            __m256 bj = _mm256_loadu_ps(pb + j * 8);
+            r[j] = mul_add(a3, _mm256_shuffle_ps(bj, bj, 0xff),
+                           mul_add(a2, _mm256_shuffle_ps(bj, bj, 0xaa),
+                                   mul_add(a1, _mm256_shuffle_ps(bj, bj, 0x55), mul(a0, _mm256_shuffle_ps(bj, bj, 0x00)))));
+        }
+        _mm256_storeu_ps(&out[i].columns[0].x, r[0]);
+        _mm256_storeu_ps(&out[i].columns[2].x, r[1]);
+#elif defined(__SSE2__)
+        __m128 a0 = _mm_load_ps(pa), a1 = _mm_load_ps(pa + 4), a2 = _mm_load_ps(pa + 8), a3 = _mm_load_ps(pa + 12);
+        __m128 r[4];
+        for (int j = 0; j < 4; j++)
+        {
+            __m128 bj = _mm_load_ps(pb + j * 4);
+            r[j] = mul_add(a3, _mm_shuffle_ps(bj, bj, 0xff),
+                           mul_add(a2, _mm_shuffle_ps(bj, bj, 0xaa),
+                                   mul_add(a1, _mm_shuffle_ps(bj, bj, 0x55), mul(a0, _mm_shuffle_ps(bj, bj, 0x00)))));
+        }
+        for (int j = 0; j < 4; j++)
+            _mm_store_ps(&out[i].columns[j].x, r[j]);
+#else
+        out[i] = a[i] * b[i];
+#endif
+    }
+}
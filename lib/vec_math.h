@@ -0,0 +1,181 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+
+// Vertex position, packed as Vec3fLayout uploads it: no padding, arrays of it are vertex buffers
+struct Vec3f
+{
+    float x;
+    float y;
+    float z;
+};
+static_assert(sizeof(Vec3f) == 12 && std::is_trivially_copyable_v<Vec3f>);
+
+[[nodiscard]] constexpr Vec3f operator+(Vec3f a, Vec3f b) noexcept
+{
+    return Vec3f{a.x + b.x, a.y + b.y, a.z + b.z};
+}
+
+[[nodiscard]] constexpr Vec3f operator-(Vec3f a, Vec3f b) noexcept
+{
+    return Vec3f{a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+[[nodiscard]] constexpr Vec3f operator*(Vec3f a, float s) noexcept
+{
+    return Vec3f{a.x * s, a.y * s, a.z * s};
+}
+
+[[nodiscard]] constexpr float dot(Vec3f a, Vec3f b) noexcept
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+[[nodiscard]] constexpr Vec3f cross(Vec3f a, Vec3f b) noexcept
+{
+    return Vec3f{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+}
+
+[[nodiscard]] inline Vec3f normalize(Vec3f a) noexcept
+{
+    return a * (1.f / std::sqrt(dot(a, a)));
+}
+
+// One SSE register, w is 1 for points and 0 for directions
+struct alignas(16) Vec4f
+{
+    float x;
+    float y;
+    float z;
+    float w;
+};
+
+[[nodiscard]] constexpr Vec4f operator+(Vec4f a, Vec4f b) noexcept
+{
+    return Vec4f{a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+}
+
+[[nodiscard]] constexpr Vec4f operator*(Vec4f a, float s) noexcept
+{
+    return Vec4f{a.x * s, a.y * s, a.z * s, a.w * s};
+}
+
+[[nodiscard]] constexpr float dot(Vec4f a, Vec4f b) noexcept
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+}
+
+// Column-major like GL expects it from glUniformMatrix4fv without transposing, so
+// columns[3] is the translation and M * v is columns[0] * v.x + ... + columns[3] * v.w
+struct alignas(16) Mat4f
+{
+    Vec4f columns[4];
+
+    [[nodiscard]] static constexpr Mat4f identity() noexcept
+    {
+        return Mat4f{{{1.f, 0.f, 0.f, 0.f}, {0.f, 1.f, 0.f, 0.f}, {0.f, 0.f, 1.f, 0.f}, {0.f, 0.f, 0.f, 1.f}}};
+    }
+
+    [[nodiscard]] static constexpr Mat4f translation(Vec3f t) noexcept
+    {
+        return Mat4f{{{1.f, 0.f, 0.f, 0.f}, {0.f, 1.f, 0.f, 0.f}, {0.f, 0.f, 1.f, 0.f}, {t.x, t.y, t.z, 1.f}}};
+    }
+
+    [[nodiscard]] static constexpr Mat4f scale(Vec3f s) noexcept
+    {
+        return Mat4f{{{s.x, 0.f, 0.f, 0.f}, {0.f, s.y, 0.f, 0.f}, {0.f, 0.f, s.z, 0.f}, {0.f, 0.f, 0.f, 1.f}}};
+    }
+
+    [[nodiscard]] constexpr const float *data() const noexcept
+    {
+        return &columns[0].x;
+    }
+};
+static_assert(sizeof(Mat4f) == 16 * sizeof(float));
+
+// Single products stay scalar and constexpr, the compiler vectorizes them well enough inline; the
+// batched versions below are the SIMD kernels
+[[nodiscard]] constexpr Vec4f operator*(const Mat4f &m, Vec4f v) noexcept
+{
+    return m.columns[0] * v.x + m.columns[1] * v.y + m.columns[2] * v.z + m.columns[3] * v.w;
+}
+
+[[nodiscard]] constexpr Mat4f operator*(const Mat4f &a, const Mat4f &b) noexcept
+{
+    return Mat4f{{a * b.columns[0], a * b.columns[1], a * b.columns[2], a * b.columns[3]}};
+}
+
+// Affine, the bottom row is taken as 0 0 0 1
+[[nodiscard]] constexpr Vec3f transform_point(const Mat4f &m, Vec3f p) noexcept
+{
+    Vec4f r = m * Vec4f{p.x, p.y, p.z, 1.f};
+    return Vec3f{r.x, r.y, r.z};
+}
+
+// Unit quaternion rotation, w is the real part
+struct alignas(16) Quatf
+{
+    float x;
+    float y;
+    float z;
+    float w;
+
+    [[nodiscard]] static constexpr Quatf identity() noexcept
+    {
+        return Quatf{0.f, 0.f, 0.f, 1.f};
+    }
+
+    // `axis` normalized
+    [[nodiscard]] static Quatf axis_angle(Vec3f axis, float radians) noexcept
+    {
+        float s = std::sin(radians * .5f);
+        return Quatf{axis.x * s, axis.y * s, axis.z * s, std::cos(radians * .5f)};
+    }
+
+    [[nodiscard]] constexpr Mat4f matrix() const noexcept
+    {
+        return Mat4f{{{1.f - 2.f * (y * y + z * z), 2.f * (x * y + z * w), 2.f * (x * z - y * w), 0.f},
+                      {2.f * (x * y - z * w), 1.f - 2.f * (x * x + z * z), 2.f * (y * z + x * w), 0.f},
+                      {2.f * (x * z + y * w), 2.f * (y * z - x * w), 1.f - 2.f * (x * x + y * y), 0.f},
+                      {0.f, 0.f, 0.f, 1.f}}};
+    }
+};
+
+// a after b
+[[nodiscard]] constexpr Quatf operator*(Quatf a, Quatf b) noexcept
+{
+    return Quatf{a.w * b.x + a.x * b.w + a.y * b.z - a.z * b.y,
+                 a.w * b.y - a.x * b.z + a.y * b.w + a.z * b.x,
+                 a.w * b.z + a.x * b.y - a.y * b.x + a.z * b.w,
+                 a.w * b.w - a.x * b.x - a.y * b.y - a.z * b.z};
+}
+
+[[nodiscard]] constexpr Vec3f rotate(Quatf q, Vec3f v) noexcept
+{
+    // v + 2w (u x v) + 2 u x (u x v), u the vector part
+    Vec3f u{q.x, q.y, q.z};
+    Vec3f t = cross(u, v) * 2.f;
+    return v + t * q.w + cross(u, t);
+}
+
+// Translation, rotation, then scale applied to points, in that reading order
+[[nodiscard]] constexpr Mat4f compose(Vec3f translation, Quatf rotation, Vec3f scale) noexcept
+{
+    Mat4f m = rotation.matrix();
+    for (int i = 0; i < 3; i++)
+        m.columns[i] = m.columns[i] * (i == 0 ? scale.x : i == 1 ? scale.y : scale.z);
+    m.columns[3] = Vec4f{translation.x, translation.y, translation.z, 1.f};
+    return m;
+}
+
+// Batched kernels: AVX 8 at a time, SSE 4 at a time, scalar for the rest or without either. They
+// match the scalar products exactly unless FMA is enabled, which skips a rounding.
+
+// out[i] = m * points[i] as transform_point, `out` may be `points`
+void transform_points(const Mat4f &m, const std::span<const Vec3f> points, const std::span<Vec3f> out) noexcept;
+
+// out[i] = a[i] * b[i], `out` may be `a` or `b`
+void multiply_matrices(const std::span<const Mat4f> a, const std::span<const Mat4f> b, const std::span<Mat4f> out) noexcept;
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// GL enums, this header is included before glad in some translation units
+constexpr unsigned int VERTEX_GL_BYTE = 0x1400;
+constexpr unsigned int VERTEX_GL_UNSIGNED_BYTE = 0x1401;
+constexpr unsigned int VERTEX_GL_SHORT = 0x1402;
+constexpr unsigned int VERTEX_GL_UNSIGNED_SHORT = 0x1403;
+constexpr unsigned int VERTEX_GL_INT = 0x1404;
+constexpr unsigned int VERTEX_GL_UNSIGNED_INT = 0x1405;
+constexpr unsigned int VERTEX_GL_FLOAT = 0x1406;
+constexpr unsigned int VERTEX_GL_HALF_FLOAT = 0x140B;
+constexpr unsigned int VERTEX_GL_UNSIGNED_INT_2_10_10_10_REV = 0x8368;
+constexpr unsigned int VERTEX_GL_INT_2_10_10_10_REV = 0x8D9F;
+
+// Attribute locations, shaders declare them with layout (location = N)
+enum class VertexSemantic : unsigned int
+{
+    Position = 0,
+    Normal = 1,
+    TexCoord = 2,
+    Color = 3,
+    InstanceTransform = 4, // Per-instance, divisor 1
+    InstanceColor = 5,
+};
+
+// Packed component types, one value holds every component
+struct Half
+{
+    uint16_t bits;
+};
+
+struct Packed1010102
+{
+    uint32_t bits;
+};
+
+struct PackedSnorm1010102
+{
+    int32_t bits;
+};
+
+template <typename T>
+struct VertexComponent;
+
+#define VERTEX_COMPONENT(TYPE, GL_TYPE, PACKED)                  \
+    template <>                                                  \
+    struct VertexComponent<TYPE>                                 \
+    {                                                            \
+        static constexpr unsigned int gl_type = GL_TYPE;         \
+        static constexpr bool packed = PACKED;                   \
+    }
+VERTEX_COMPONENT(int8_t, VERTEX_GL_BYTE, false);
+VERTEX_COMPONENT(uint8_t, VERTEX_GL_UNSIGNED_BYTE, false);
+VERTEX_COMPONENT(int16_t, VERTEX_GL_SHORT, false);
+VERTEX_COMPONENT(uint16_t, VERTEX_GL_UNSIGNED_SHORT, false);
+VERTEX_COMPONENT(int32_t, VERTEX_GL_INT, false);
+VERTEX_COMPONENT(uint32_t, VERTEX_GL_UNSIGNED_INT, false);
+VERTEX_COMPONENT(float, VERTEX_GL_FLOAT, false);
+VERTEX_COMPONENT(Half, VERTEX_GL_HALF_FLOAT, false);
+VERTEX_COMPONENT(Packed1010102, VERTEX_GL_UNSIGNED_INT_2_10_10_10_REV, true);
+VERTEX_COMPONENT(PackedSnorm1010102, VERTEX_GL_INT_2_10_10_10_REV, true);
+#undef VERTEX_COMPONENT
+
+// One attribute, e.g. VertexAttrib<VertexSemantic::Color, uint8_t, 4, true> for normalized RGBA8
+template <VertexSemantic Semantic, typename T, int N, bool Normalized = false, unsigned int Location = (unsigned int)Semantic>
+struct VertexAttrib
+{
+    static_assert(N >= 1 && N <= 4, "Vertex attributes have 1 to 4 components");
+    static_assert(!VertexComponent<T>::packed || N == 4, "Packed 2_10_10_10 attributes have 4 components");
+
+    static constexpr VertexSemantic semantic = Semantic;
+    static constexpr unsigned int location = Location;
+    static constexpr unsigned int gl_type = VertexComponent<T>::gl_type;
+    static constexpr int components = N;
+    static constexpr bool normalized = Normalized;
+    static constexpr size_t size = VertexComponent<T>::packed ? sizeof(T) : sizeof(T) * N;
+};
+
+// What App needs to set up one glVertexAttribPointer
+struct VertexAttribDesc
+{
+    VertexSemantic semantic;
+    unsigned int location;
+    unsigned int gl_type;
+    int components;
+    bool normalized;
+    int stream; // Index of the data stream holding the attribute
+    int stride;
+    size_t offset;
+};
+
+// GL wants every attribute 4 byte aligned
+[[nodiscard]] constexpr size_t vertex_align(size_t offset) noexcept
+{
+    return (offset + 3) & ~(size_t)3;
+}
+
+// All attributes of a vertex stored together in one stream (AoS)
+template <typename... Attribs>
+struct InterleavedLayout
+{
+private:
+    static constexpr std::array<size_t, sizeof...(Attribs)> offsets()
+    {
+        std::array<size_t, sizeof...(Attribs)> out{};
+        size_t offset = 0, i = 0;
+        ((out[i++] = offset, offset = vertex_align(offset + Attribs::size)), ...);
+        return out;
+    }
+
+public:
+    static constexpr bool interleaved = true;
+    static constexpr int n_streams = 1;
+    static constexpr int stride = (int)(vertex_align(Attribs::size) + ... + 0);
+
+    static constexpr std::array<VertexAttribDesc, sizeof...(Attribs)> attribs = []
+    {
+        constexpr auto offset = offsets();
+        size_t i = 0;
+        return std::array<VertexAttribDesc, sizeof...(Attribs)>{
+            VertexAttribDesc{Attribs::semantic, Attribs::location, Attribs::gl_type, Attribs::components, Attribs::normalized, 0, stride, offset[i++]}...};
+    }();
+};
+
+// One tightly packed stream per attribute (SoA)
+template <typename... Attribs>
+struct SeparateLayout
+{
+public:
+    static constexpr bool interleaved = false;
+    static constexpr int n_streams = sizeof...(Attribs);
+
+    static constexpr std::array<VertexAttribDesc, sizeof...(Attribs)> attribs = []
+    {
+        int stream = 0;
+        return std::array<VertexAttribDesc, sizeof...(Attribs)>{
+            VertexAttribDesc{Attribs::semantic, Attribs::location, Attribs::gl_type, Attribs::components, Attribs::normalized, stream++, (int)Attribs::size, 0}...};
+    }();
+
+    // Element type of every stream must have the size of its attribute
+    template <typename... Streams>
+    [[nodiscard]] static constexpr bool matches() noexcept
+    {
+        return sizeof...(Streams) == sizeof...(Attribs) && ((sizeof(Streams) == Attribs::size) && ...);
+    }
+};
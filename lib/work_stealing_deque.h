@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Chase-Lev deque of N slots: the owner thread pushes and pops at the bottom, any thread steals
+// from the top. Lock-free, with the memory orders of Le et al., "Correct and Efficient
+// Work-Stealing for Weak Memory Models". Holds small trivially copyable values, e.g. job handles.
+template <typename T, size_t N>
+class WorkStealingDeque
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T> && std::atomic<T>::is_always_lock_free);
+
+private:
+    alignas(64) std::atomic<int64_t> m_top;
+    alignas(64) std::atomic<int64_t> m_bottom;
+    std::array<std::atomic<T>, N> m_slots;
+
+public:
+    WorkStealingDeque() noexcept
+        : m_top(0), m_bottom(0)
+    {
+    }
+    WorkStealingDeque(const WorkStealingDeque &) = delete;
+    WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+    // Owner only, false when full
+    [[nodiscard]] bool push(T value) noexcept
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top >= (int64_t)N)
+            return false;
+
+        m_slots[bottom & (N - 1)].store(value, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner only, newest first
+    [[nodiscard]] bool pop(T &value) noexcept
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return false;
+        }
+        value = m_slots[bottom & (N - 1)].load(std::memory_order_relaxed);
+        if (top < bottom)
+            return true;
+
+        // Last one, race the thieves for it
+        bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    // Any thread, oldest first. False when empty or another thread got it first.
+    [[nodiscard]] bool steal(T &value) noexcept
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return false;
+
+        value = m_slots[top & (N - 1)].load(std::memory_order_relaxed);
+        return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+};
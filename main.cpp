@@ -1,18 +1,35 @@
 #include <array>
-#include <filesystem>
-#include <fstream>
-#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <string_view>
 
 #include "lib/app.h"
+#include "lib/asset.h"
 #include "lib/constant.h"
+#include "lib/job_system.h"
+#include "lib/trace.h"
 
 #define WIDTH 800
 #define HEIGHT 600
+#define DEFAULT_HEADLESS_FRAMES 1000
 
 #define VERTEX_SHADER_SOURCE_FILE "shaders/vertex.glsl"
 #define FRAGMENT_SHADER_SOURCE_FILE "shaders/frag.glsl"
 
+#ifdef APP_EMBED_ASSETS
+#include <filesystem>
+
+#include "lib/embedded_assets.h"
+
+// Baked in by tools/embed_assets.cpp, the program cache key needs no hashing at startup either
+constexpr std::string_view V_SHADERS[] = {embedded::asset(VERTEX_SHADER_SOURCE_FILE).data};
+constexpr std::string_view F_SHADERS[] = {embedded::asset(FRAGMENT_SHADER_SOURCE_FILE).data};
+constexpr uint64_t V_SHADER_HASHES[] = {embedded::asset(VERTEX_SHADER_SOURCE_FILE).hash};
+constexpr uint64_t F_SHADER_HASHES[] = {embedded::asset(FRAGMENT_SHADER_SOURCE_FILE).hash};
+constexpr uint64_t PROGRAM_SOURCE_HASH = program_source_hash(V_SHADER_HASHES, F_SHADER_HASHES);
+#endif
+
 // define vertices & elements
 constexpr std::array<const Vec3f, 4> VERTICES = {
     Vec3f{-0.5f, 0.5f, 0.0f},
@@ -30,44 +47,113 @@ constexpr std::array<const unsigned int, 6> ELEMENTS = {
     3,
 };
 
-std::string read_file(const std::string_view file_name)
+void print_profile(const ProfileSummary &summary)
 {
-    // Check for size
-    auto size = std::filesystem::file_size(file_name);
-
-    // Reserve buffer
-    std::string retval(size, '\0');
-
-    // Read file
-    std::ifstream in(file_name.data());
-    in.read(retval.data(), size);
-
-    return retval;
+    printf("%-10s %10s %10s %10s\n", "ms", "p50", "p95", "p99");
+    for (int phase = 0; phase < N_FRAME_PHASE; phase++)
+    {
+        const PercentileSummary &p = summary.cpu_ms[phase];
+        printf("%-10s %10.4f %10.4f %10.4f\n", frame_phase_name((FramePhase)phase), p.p50, p.p95, p.p99);
+    }
+    printf("%-10s %10.4f %10.4f %10.4f\n", "cpu total", summary.cpu_total_ms.p50, summary.cpu_total_ms.p95, summary.cpu_total_ms.p99);
+    if (summary.n_gpu_frames)
+        printf("%-10s %10.4f %10.4f %10.4f\n", "gpu", summary.gpu_ms.p50, summary.gpu_ms.p95, summary.gpu_ms.p99);
 }
 
-int main()
+int main(int argc, char **argv)
 {
+    TRACE_THREAD_NAME("main");
+    TraceTimeline startup;
+    TRACE_NEXT(startup, "startup");
     puts("Starting...");
 
-    // Read shaders
+    // Parse args, `--headless [frames]` and `--software [frames]` render offscreen for a fixed number of frames,
+    // `--trace file.json` writes the recorded spans on exit, `--render-thread` draws on a thread of its own
+    AppMode mode = AppMode::Window;
+    long n_frames = 0;
+    const char *trace_path = nullptr;
+    bool render_thread = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--headless") == 0)
+            mode = AppMode::Headless;
+        else if (strcmp(argv[i], "--software") == 0)
+            mode = AppMode::Software;
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            trace_path = argv[++i];
+        else if (strcmp(argv[i], "--render-thread") == 0)
+            render_thread = true;
+        else
+            n_frames = atol(argv[i]);
+    }
+    if (mode != AppMode::Window && n_frames <= 0)
+        n_frames = DEFAULT_HEADLESS_FRAMES;
+
+#ifndef APP_EMBED_ASSETS
+    // Start reading shaders, they page in while the context is created
     puts("Reading shaders...");
-    const std::string v_shader = read_file(VERTEX_SHADER_SOURCE_FILE);
-    const char *const v_shaders[] = {v_shader.c_str()};
-    const std::string f_shader = read_file(FRAGMENT_SHADER_SOURCE_FILE);
-    const char *const f_shaders[] = {f_shader.c_str()};
+    AssetLoader assets;
+    assets.prefetch(VERTEX_SHADER_SOURCE_FILE);
+    assets.prefetch(FRAGMENT_SHADER_SOURCE_FILE);
+#endif
 
     // Initialize app
     puts("Initializing app...");
-    App app(WIDTH, HEIGHT, WIN_TITLE);
+    App app(WIDTH, HEIGHT, WIN_TITLE, mode);
+    if (render_thread)
+        app.use_render_thread();
     app.use_vertices(VERTICES, ELEMENTS);
+#ifdef APP_EMBED_ASSETS
+    app.use_shaders(V_SHADERS, F_SHADERS, PROGRAM_SOURCE_HASH);
+#else
+    const std::string_view v_shaders[] = {assets.get(VERTEX_SHADER_SOURCE_FILE).text()};
+    const std::string_view f_shaders[] = {assets.get(FRAGMENT_SHADER_SOURCE_FILE).text()};
     app.use_shaders(v_shaders, f_shaders);
-    auto window = app.window();
+#endif
+    ProgramCacheStats cache_stats = app.program_cache_stats();
+    printf("Program cache: %lu hits, %lu compiles, %lu rejected\n", cache_stats.hits, cache_stats.compiles, cache_stats.rejected);
+#ifdef APP_EMBED_ASSETS
+    // The embedded build runs without the sources on disk, they are only watched when present
+    bool sources_on_disk = std::filesystem::is_directory(std::filesystem::path(VERTEX_SHADER_SOURCE_FILE).parent_path());
+#else
+    bool sources_on_disk = true;
+#endif
+    if (mode != AppMode::Window)
+        app.enable_profiler();
+    else if (sources_on_disk)
+        app.watch_shaders(VERTEX_SHADER_SOURCE_FILE, FRAGMENT_SHADER_SOURCE_FILE);
 
     // Main loop
+    TRACE_END(startup);
     puts("Running...");
+    auto start = std::chrono::steady_clock::now();
+    long frame = 0;
     while (!app.done())
     {
         app.update();
+        if (mode != AppMode::Window && ++frame >= n_frames)
+            app.close();
+    }
+
+    if (mode != AppMode::Window)
+    {
+        double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        printf("Rendered %ld frames in %.3fs (%.1f fps)\n", frame, elapsed, frame / elapsed);
+        print_profile(app.profiler()->summary());
+        GlStateStats gl_stats = app.gl_state_stats();
+        printf("GL state calls last frame: %lu issued, %lu elided\n", gl_stats.issued, gl_stats.elided);
+        for (size_t worker = 0; worker < app.job_stats().size(); worker++)
+        {
+            const JobWorkerStats &jobs = app.job_stats()[worker];
+            printf("Job worker %zu last frame: %lu jobs, %lu steals, %.3fms busy (%.0f%%)\n", worker, jobs.jobs, jobs.steals, jobs.busy_ms, jobs.utilization * 100);
+        }
+    }
+
+    if (trace_path)
+    {
+        trace_write(trace_path);
+        TraceStats trace = trace_stats();
+        printf("Trace: %lu spans written to %s, %lu dropped\n", trace.spans, trace_path, trace.dropped);
     }
 
     puts("Closing...");
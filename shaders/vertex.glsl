@@ -1,11 +1,46 @@
 #version 330 core
 
+// Permutation switches, App::shader_variant overrides them
+#ifndef INSTANCING
+#define INSTANCING 1
+#endif
+#ifndef VERTEX_COLOR
+#define VERTEX_COLOR 1
+#endif
+
 layout (location = 0) in vec3 aPos;
-uniform float colorOffset;
-uniform float posOffset;
+layout (location = 4) in vec4 aInstance;      // xyz offset, w scale, (0, 0, 0, 1) when not instanced
+layout (location = 5) in vec4 aInstanceColor; // rgb tint, (1, 1, 1, 1) when not instanced
+
+// Shared by every draw of a frame
+layout (std140) uniform FrameData
+{
+    float colorOffset;
+    float posOffset;
+};
+
+// Per submitted object, identity unless the draw was submitted with object data
+layout (std140) uniform ObjectData
+{
+    vec4 objectOffset; // xyz offset, w scale
+    vec4 objectColor;  // rgb tint
+};
+
 out vec4 vertexColor;
 
 void main() {
-    gl_Position = vec4(aPos.x + posOffset, aPos.y + posOffset, aPos.z, 1.0);
-    vertexColor = vec4((aPos.x * 2 + 1 + colorOffset) / 3, (aPos.y * 2 + 1 + colorOffset) / 3, (aPos.z * 2 + 1 + colorOffset) / 3, 1.0);
+#if INSTANCING
+    vec3 pos = aPos * aInstance.w + aInstance.xyz;
+    vec3 tint = aInstanceColor.rgb * objectColor.rgb;
+#else
+    vec3 pos = aPos;
+    vec3 tint = objectColor.rgb;
+#endif
+    pos = pos * objectOffset.w + objectOffset.xyz;
+    gl_Position = vec4(pos.x + posOffset, pos.y + posOffset, pos.z, 1.0);
+#if VERTEX_COLOR
+    vertexColor = vec4((aPos.x * 2 + 1 + colorOffset) / 3, (aPos.y * 2 + 1 + colorOffset) / 3, (aPos.z * 2 + 1 + colorOffset) / 3, 1.0) * vec4(tint, 1.0);
+#else
+    vertexColor = vec4(tint, 1.0);
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,110 @@
+// Generates lib/embedded_assets.h for builds with -DAPP_EMBED_ASSETS, see the README
+//   embed_assets lib/embedded_assets.h shaders/vertex.glsl shaders/frag.glsl
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "../lib/file.h"
+#include "../lib/hash.h"
+
+constexpr size_t EMBED_LINE_BYTES = 96;
+
+// shaders/vertex.glsl -> SHADERS_VERTEX_GLSL
+static std::string identifier(std::string_view path)
+{
+    std::string retval;
+    for (char c : path)
+        retval += isalnum((unsigned char)c) ? (char)toupper((unsigned char)c) : '_';
+    if (retval.empty() || isdigit((unsigned char)retval[0]))
+        retval.insert(0, "_");
+    return retval;
+}
+
+// Binary safe: printable ASCII stays readable, everything else becomes a 3 digit octal escape
+static std::string literal(std::string_view data)
+{
+    std::string retval = "\"";
+    size_t line = 0;
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        unsigned char c = data[i];
+        if (c == '\n')
+            retval += "\\n";
+        else if (c == '"' || c == '\\')
+            retval += std::format("\\{}", (char)c);
+        else if (c >= 0x20 && c < 0x7F)
+            retval += (char)c;
+        else
+            retval += std::format("\\{}{}{}", (char)('0' + (c >> 6)), (char)('0' + ((c >> 3) & 7)), (char)('0' + (c & 7)));
+
+        // Break after newlines and long runs, the pieces are concatenated back by the compiler
+        if ((c == '\n' || ++line >= EMBED_LINE_BYTES) && i + 1 < data.size())
+        {
+            retval += "\"\n    \"";
+            line = 0;
+        }
+    }
+    return retval + "\"";
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <output.h> <file>...\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        std::string out = "// Generated by tools/embed_assets.cpp, do not edit\n#pragma once\n\n"
+                          "#include <cstdint>\n#include <stdexcept>\n#include <string_view>\n\n"
+                          "namespace embedded\n{\n"
+                          "struct EmbeddedAsset\n{\n"
+                          "    std::string_view path;\n"
+                          "    std::string_view data;\n"
+                          "    uint64_t hash; // hash64 of data\n"
+                          "};\n\n";
+
+        // One constant per file, the table below refers to them
+        std::string table = "constexpr EmbeddedAsset ASSETS[] = {\n";
+        for (int i = 2; i < argc; i++)
+        {
+            std::string path = std::filesystem::path(argv[i]).generic_string();
+            std::string data = read_file(path);
+            std::string name = identifier(path);
+            out += std::format("constexpr std::string_view {}(\n    {},\n    {});\n", name, literal(data), data.size());
+            out += std::format("constexpr uint64_t {}_HASH = 0x{:016x}ull;\n\n", name, hash64(data));
+            table += std::format("    {{\"{}\", {}, {}_HASH}},\n", path, name, name);
+        }
+        out += table + "};\n\n";
+        out += "// Lookup by the path given to the generator, unknown paths fail to compile\n"
+               "consteval const EmbeddedAsset &asset(std::string_view path)\n{\n"
+               "    for (const EmbeddedAsset &asset : ASSETS)\n"
+               "        if (asset.path == path)\n"
+               "            return asset;\n"
+               "    throw std::logic_error(\"Asset was not embedded\");\n"
+               "}\n"
+               "} // namespace embedded\n";
+
+        // Only touch the header when it changes, keeps rebuilds incremental
+        std::error_code error;
+        if (std::filesystem::exists(argv[1], error) && read_file(argv[1]) == out)
+            return 0;
+        std::ofstream file(argv[1], std::ios::binary);
+        file << out;
+        if (!file)
+            throw std::runtime_error(std::format("Failed to write {}", argv[1]));
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
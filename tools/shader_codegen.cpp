@@ -0,0 +1,504 @@
+// Generates lib/shader_bindings.h from the GLSL sources, see the README
+//   shader_codegen lib/shader_bindings.h shaders/*.glsl
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../lib/file.h"
+
+struct GlslType
+{
+    const char *name;
+    const char *cpp_type; // Component type
+    int columns;          // 1 unless a matrix
+    int rows;             // Components per column
+};
+
+constexpr GlslType GLSL_TYPES[] = {
+    {"float", "float", 1, 1},
+    {"vec2", "float", 1, 2},
+    {"vec3", "float", 1, 3},
+    {"vec4", "float", 1, 4},
+    {"int", "int32_t", 1, 1},
+    {"ivec2", "int32_t", 1, 2},
+    {"ivec3", "int32_t", 1, 3},
+    {"ivec4", "int32_t", 1, 4},
+    {"uint", "uint32_t", 1, 1},
+    {"uvec2", "uint32_t", 1, 2},
+    {"uvec3", "uint32_t", 1, 3},
+    {"uvec4", "uint32_t", 1, 4},
+    {"bool", "uint32_t", 1, 1},
+    {"bvec2", "uint32_t", 1, 2},
+    {"bvec3", "uint32_t", 1, 3},
+    {"bvec4", "uint32_t", 1, 4},
+    {"mat2", "float", 2, 2},
+    {"mat3", "float", 3, 3},
+    {"mat4", "float", 4, 4},
+    {"mat2x3", "float", 2, 3},
+    {"mat2x4", "float", 2, 4},
+    {"mat3x2", "float", 3, 2},
+    {"mat3x4", "float", 3, 4},
+    {"mat4x2", "float", 4, 2},
+    {"mat4x3", "float", 4, 3},
+};
+
+// Qualifiers that do not change the declaration's meaning for the bindings
+constexpr std::string_view IGNORED_QUALIFIERS[] = {"flat", "smooth", "noperspective", "centroid", "invariant",
+                                                   "highp", "mediump", "lowp", "const"};
+
+struct Declaration
+{
+    std::map<std::string, std::string> layout; // layout(key = value, key), values empty when absent
+    std::string storage;                       // in, out, uniform or empty
+    std::string type;
+    std::string name;
+    int array_size; // 0 when not an array
+};
+
+struct BlockMember
+{
+    std::string name;
+    const GlslType *type;
+    int array_size;
+    size_t offset;
+    size_t size;
+};
+
+struct UniformBlock
+{
+    std::string name;
+    std::string source; // File that declared it first
+    std::vector<BlockMember> members;
+    size_t size;
+};
+
+struct ShaderFile
+{
+    std::string stem;
+    std::vector<Declaration> inputs; // Only the ones with an explicit location
+    std::vector<Declaration> outputs;
+    std::vector<Declaration> uniforms;
+};
+
+static const GlslType *find_type(std::string_view name)
+{
+    for (const GlslType &type : GLSL_TYPES)
+        if (name == type.name)
+            return &type;
+    return nullptr;
+}
+
+// aInstanceColor -> a_instance_color
+static std::string snake_case(std::string_view name)
+{
+    std::string retval;
+    for (size_t i = 0; i < name.size(); i++)
+    {
+        char c = name[i];
+        if (isupper((unsigned char)c) && i > 0 && name[i - 1] != '_' && !isupper((unsigned char)name[i - 1]))
+            retval += '_';
+        retval += (char)tolower((unsigned char)c);
+    }
+    return retval;
+}
+
+static std::string upper_case(std::string_view name)
+{
+    std::string retval = snake_case(name);
+    for (char &c : retval)
+        c = (char)toupper((unsigned char)c);
+    return retval;
+}
+
+// Identifiers, numbers and single punctuation characters, comments and preprocessor lines dropped
+static std::vector<std::string> tokenize(std::string_view source)
+{
+    std::vector<std::string> tokens;
+    size_t i = 0;
+    bool line_start = true;
+    while (i < source.size())
+    {
+        char c = source[i];
+        if (c == '\n')
+        {
+            line_start = true;
+            i++;
+        }
+        else if (isspace((unsigned char)c))
+        {
+            i++;
+        }
+        else if (line_start && c == '#')
+        {
+            while (i < source.size() && source[i] != '\n')
+                i++;
+        }
+        else if (source.substr(i, 2) == "//")
+        {
+            while (i < source.size() && source[i] != '\n')
+                i++;
+        }
+        else if (source.substr(i, 2) == "/*")
+        {
+            size_t end = source.find("*/", i + 2);
+            i = end == std::string_view::npos ? source.size() : end + 2;
+        }
+        else if (isalnum((unsigned char)c) || c == '_')
+        {
+            size_t start = i;
+            while (i < source.size() && (isalnum((unsigned char)source[i]) || source[i] == '_' || source[i] == '.'))
+                i++;
+            tokens.emplace_back(source.substr(start, i - start));
+            line_start = false;
+        }
+        else
+        {
+            tokens.emplace_back(1, c);
+            line_start = false;
+            i++;
+        }
+    }
+    return tokens;
+}
+
+class Parser
+{
+private:
+    std::string m_file;
+    std::vector<std::string> m_tokens;
+    size_t m_pos;
+
+    [[nodiscard]] bool done() const noexcept
+    {
+        return m_pos >= m_tokens.size();
+    }
+
+    [[nodiscard]] const std::string &peek() const
+    {
+        if (done())
+            throw std::runtime_error(std::format("{}: unexpected end of file", m_file));
+        return m_tokens[m_pos];
+    }
+
+    const std::string &next()
+    {
+        const std::string &token = peek();
+        m_pos++;
+        return token;
+    }
+
+    void expect(std::string_view token)
+    {
+        if (next() != token)
+            throw std::runtime_error(std::format("{}: expected '{}' before '{}'", m_file, token, m_tokens[m_pos - 1]));
+    }
+
+    int parse_array_size()
+    {
+        if (done() || peek() != "[")
+            return 0;
+        next();
+        int size = std::stoi(next());
+        expect("]");
+        if (size <= 0)
+            throw std::runtime_error(std::format("{}: array size must be positive", m_file));
+        return size;
+    }
+
+    void skip_braces()
+    {
+        int depth = 0;
+        do
+        {
+            const std::string &token = next();
+            if (token == "{")
+                depth++;
+            else if (token == "}")
+                depth--;
+        } while (depth > 0);
+    }
+
+    // Qualifiers up to the type, layout(...) included
+    void parse_qualifiers(Declaration &decl)
+    {
+        while (!done())
+        {
+            const std::string &token = peek();
+            if (token == "layout")
+            {
+                next();
+                expect("(");
+                while (peek() != ")")
+                {
+                    std::string key = next();
+                    std::string value;
+                    if (peek() == "=")
+                    {
+                        next();
+                        value = next();
+                    }
+                    decl.layout[key] = value;
+                    if (peek() == ",")
+                        next();
+                }
+                expect(")");
+            }
+            else if (token == "in" || token == "out" || token == "uniform")
+            {
+                decl.storage = next();
+            }
+            else if (std::find(std::begin(IGNORED_QUALIFIERS), std::end(IGNORED_QUALIFIERS), token) != std::end(IGNORED_QUALIFIERS))
+            {
+                next();
+            }
+            else
+            {
+                return;
+            }
+        }
+    }
+
+    void parse_block(Declaration &decl, std::vector<UniformBlock> &blocks)
+    {
+        if (!decl.layout.contains("std140"))
+            throw std::runtime_error(std::format("{}: uniform block {} must be std140, other layouts have no fixed offsets", m_file, decl.type));
+
+        UniformBlock block{decl.type, m_file, {}, 0};
+        expect("{");
+        while (peek() != "}")
+        {
+            Declaration member{};
+            parse_qualifiers(member);
+            const GlslType *type = find_type(next());
+            if (!type)
+                throw std::runtime_error(std::format("{}: unsupported type '{}' in block {}", m_file, m_tokens[m_pos - 1], block.name));
+
+            // Several names may share one type
+            while (true)
+            {
+                std::string name = next();
+                int array_size = parse_array_size();
+
+                // std140: vec3 aligns like vec4, arrays and matrix columns have a vec4 stride
+                size_t base = type->rows == 3 ? 16 : type->rows * 4;
+                size_t alignment = array_size || type->columns > 1 ? 16 : base;
+                size_t element = type->columns > 1 ? type->columns * 16 : (array_size ? 16 : type->rows * 4);
+                size_t size = element * std::max(array_size, 1);
+                block.size = (block.size + alignment - 1) / alignment * alignment;
+                block.members.push_back(BlockMember{name, type, array_size, block.size, size});
+                block.size += size;
+
+                if (peek() != ",")
+                    break;
+                next();
+            }
+            expect(";");
+        }
+        expect("}");
+        block.size = (block.size + 15) / 16 * 16;
+
+        // Instance name
+        if (peek() != ";")
+            next();
+        expect(";");
+
+        // Stages of one program share the block, so it must match wherever it appears
+        auto existing = std::find_if(blocks.begin(), blocks.end(), [&](const UniformBlock &other)
+                                     { return other.name == block.name; });
+        if (existing == blocks.end())
+        {
+            blocks.push_back(std::move(block));
+            return;
+        }
+        bool same = existing->size == block.size && existing->members.size() == block.members.size();
+        for (size_t i = 0; same && i < block.members.size(); i++)
+            same = existing->members[i].name == block.members[i].name && existing->members[i].type == block.members[i].type &&
+                   existing->members[i].array_size == block.members[i].array_size;
+        if (!same)
+            throw std::runtime_error(std::format("{}: block {} differs from its declaration in {}", m_file, block.name, existing->source));
+    }
+
+public:
+    Parser(std::string file, std::string_view source)
+        : m_file(std::move(file)), m_tokens(tokenize(source)), m_pos(0)
+    {
+    }
+
+    void parse(ShaderFile &shader, std::vector<UniformBlock> &blocks)
+    {
+        while (!done())
+        {
+            // Top-level declarations only, function bodies are skipped
+            Declaration decl{};
+            parse_qualifiers(decl);
+            if (done())
+                break;
+            if (peek() == ";")
+            {
+                next();
+                continue;
+            }
+            decl.type = next();
+            if (decl.type == "struct")
+            {
+                // Struct types can not be mirrored yet, their declarations are skipped
+                while (peek() != "{")
+                    next();
+                skip_braces();
+                while (next() != ";")
+                    ;
+                continue;
+            }
+            if (peek() == "{")
+            {
+                if (decl.storage == "uniform")
+                    parse_block(decl, blocks);
+                else
+                    skip_braces();
+                continue;
+            }
+            decl.name = next();
+            if (peek() == "(")
+            {
+                // Function, prototype or definition
+                while (next() != ")")
+                    ;
+                if (peek() == "{")
+                    skip_braces();
+                else
+                    expect(";");
+                continue;
+            }
+            decl.array_size = parse_array_size();
+            while (next() != ";")
+                ;
+
+            if (decl.storage == "in" && decl.layout.contains("location"))
+                shader.inputs.push_back(decl);
+            else if (decl.storage == "out" && decl.layout.contains("location"))
+                shader.outputs.push_back(decl);
+            else if (decl.storage == "uniform")
+                shader.uniforms.push_back(decl);
+        }
+    }
+};
+
+static void write_block(std::string &out, const UniformBlock &block, unsigned int binding)
+{
+    std::string type = block.name;
+    std::string constant = upper_case(block.name);
+    out += std::format("// layout (std140) uniform {} in {}\n", block.name, block.source);
+    out += std::format("struct {}\n{{\n", type);
+    size_t offset = 0;
+    int n_pad = 0;
+    for (const BlockMember &member : block.members)
+    {
+        if (member.offset > offset)
+            out += std::format("    float pad{}[{}];\n", n_pad++, (member.offset - offset) / 4);
+
+        // Padded to the std140 stride, so indices match GLSL
+        std::string dims;
+        if (member.array_size)
+            dims += std::format("[{}]", member.array_size);
+        if (member.type->columns > 1)
+            dims += std::format("[{}][4]", member.type->columns);
+        else if (member.array_size)
+            dims += "[4]";
+        else if (member.type->rows > 1)
+            dims += std::format("[{}]", member.type->rows);
+        out += std::format("    {} {}{};\n", member.type->cpp_type, snake_case(member.name), dims);
+        offset = member.offset + member.size;
+    }
+    if (block.size > offset)
+        out += std::format("    float pad{}[{}];\n", n_pad, (block.size - offset) / 4);
+    out += "};\n";
+    out += std::format("static_assert(sizeof({}) == {});\n", type, block.size);
+    for (const BlockMember &member : block.members)
+        out += std::format("static_assert(offsetof({}, {}) == {});\n", type, snake_case(member.name), member.offset);
+    out += std::format("constexpr unsigned int {}_BINDING = {};\n", constant, binding);
+    out += std::format("constexpr const char *{}_NAME = \"{}\";\n\n", constant, block.name);
+}
+
+static void write_shader(std::string &out, const ShaderFile &shader)
+{
+    if (shader.inputs.empty() && shader.outputs.empty() && shader.uniforms.empty())
+        return;
+
+    out += std::format("namespace {}\n{{\n", shader.stem);
+    for (const Declaration &input : shader.inputs)
+        out += std::format("constexpr unsigned int {}_LOCATION = {}; // in {} {}\n", upper_case(input.name), input.layout.at("location"), input.type, input.name);
+    for (const Declaration &output : shader.outputs)
+        out += std::format("constexpr unsigned int {}_LOCATION = {}; // out {} {}\n", upper_case(output.name), output.layout.at("location"), output.type, output.name);
+    for (const Declaration &uniform : shader.uniforms)
+        out += std::format("constexpr UniformKey {}_KEY(\"{}\"); // uniform {} {}\n", upper_case(uniform.name), uniform.name, uniform.type, uniform.name);
+    out += std::format("}} // namespace {}\n\n", shader.stem);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <output.h> <shader.glsl>...\n", argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        // Parse, blocks are numbered in order of first appearance
+        std::vector<ShaderFile> shaders;
+        std::vector<UniformBlock> blocks;
+        for (int i = 2; i < argc; i++)
+        {
+            ShaderFile shader{std::filesystem::path(argv[i]).stem().string(), {}, {}, {}};
+            Parser(argv[i], read_file(argv[i])).parse(shader, blocks);
+            shaders.push_back(std::move(shader));
+        }
+        bool loose_uniforms = std::any_of(shaders.begin(), shaders.end(), [](const ShaderFile &shader)
+                                          { return !shader.uniforms.empty(); });
+
+        // Emit
+        std::string out = "// Generated by tools/shader_codegen.cpp from";
+        for (int i = 2; i < argc; i++)
+            out += std::format(" {}", std::filesystem::path(argv[i]).filename().string());
+        out += ", do not edit\n#pragma once\n\n#include <cstddef>\n#include <cstdint>\n";
+        if (loose_uniforms)
+            out += "\n#include \"uniform.h\"\n";
+        out += "\nnamespace shaders\n{\n";
+        for (size_t i = 0; i < blocks.size(); i++)
+            write_block(out, blocks[i], i);
+        if (!blocks.empty())
+        {
+            // Indexed by binding, for glUniformBlockBinding after linking
+            out += "constexpr const char *UNIFORM_BLOCK_NAMES[] = {";
+            for (size_t i = 0; i < blocks.size(); i++)
+                out += std::format("{}\"{}\"", i ? ", " : "", blocks[i].name);
+            out += "};\n\n";
+        }
+        for (const ShaderFile &shader : shaders)
+            write_shader(out, shader);
+        out += "} // namespace shaders\n";
+
+        // Only touch the header when it changes, keeps rebuilds incremental
+        std::error_code error;
+        if (std::filesystem::exists(argv[1], error) && read_file(argv[1]) == out)
+            return 0;
+        std::ofstream file(argv[1], std::ios::binary);
+        file << out;
+        if (!file)
+            throw std::runtime_error(std::format("Failed to write {}", argv[1]));
+    }
+    catch (const std::exception &e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}